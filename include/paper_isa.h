@@ -0,0 +1,92 @@
+#ifndef PAPER_ISA_H
+#define PAPER_ISA_H
+
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+// Structure to hold the paper's ISA format. Rows a core reads or writes are
+// relative to one of the core's base registers: the row is in the segment of
+// segmentRows rows the register names. A NoOp with the base bit loads the
+// segment in its row into base register baseReg of the core it points to.
+struct PaperISAInstruction {
+    uint8_t opType = 0;     // 2 bits (00=NoOp, 01=PROG, 10=EXE, 11=END)
+    uint8_t pointer = 0;    // 6 bits (core pointer or operation pointer)
+    bool readBit = false;   // 1 bit
+    bool writeBit = false;  // 1 bit
+    uint16_t rowAddr = 0;   // 8 bits
+    uint8_t baseReg = 0;    // 2 bits (base register the row is relative to)
+    bool setBase = false;   // 1 bit (load the base register)
+    
+    static constexpr int segmentRows = 256;
+    static constexpr int baseRegisters = 4;
+    
+    // Convert to 24-bit binary representation (as a 32-bit int for convenience)
+    uint32_t toBinary() const {
+        uint32_t result = 0;
+        
+        // Upper 8 bits: 2-bit op type + 6-bit pointer
+        result |= (opType & 0x3) << 22;
+        result |= (pointer & 0x3F) << 16;
+        
+        // Next 10 bits: read bit + write bit + 8-bit row address
+        result |= (readBit ? 1 : 0) << 15;
+        result |= (writeBit ? 1 : 0) << 14;
+        result |= (rowAddr & 0xFF) << 6;
+        
+        // Lower 6 bits: 2-bit base register + base bit; the rest are reserved
+        // (set to 0)
+        result |= (baseReg & 0x3) << 4;
+        result |= (setBase ? 1 : 0) << 3;
+        
+        return result;
+    }
+    
+    // Convert back from the binary representation
+    static PaperISAInstruction fromBinary(uint32_t binary) {
+        PaperISAInstruction inst;
+        inst.opType = binary >> 22 & 0x3;
+        inst.pointer = binary >> 16 & 0x3F;
+        inst.readBit = binary >> 15 & 1;
+        inst.writeBit = binary >> 14 & 1;
+        inst.rowAddr = binary >> 6 & 0xFF;
+        inst.baseReg = binary >> 4 & 0x3;
+        inst.setBase = binary >> 3 & 1;
+        return inst;
+    }
+    
+    bool operator==(const PaperISAInstruction& other) const {
+        return opType == other.opType && pointer == other.pointer && readBit == other.readBit &&
+               writeBit == other.writeBit && rowAddr == other.rowAddr && baseReg == other.baseReg &&
+               setBase == other.setBase;
+    }
+    
+    // Convert to string representation
+    std::string toString() const {
+        std::stringstream ss;
+        
+        // Convert to binary and format as 6 hex digits
+        ss << std::hex << std::setw(6) << std::setfill('0') << toBinary();
+        
+        // Add operation type
+        ss << " ";
+        switch (opType) {
+            case 0: ss << (setBase ? "BASE" : "NoOp"); break;
+            case 1: ss << "PROG"; break;
+            case 2: ss << "EXE"; break;
+            case 3: ss << "END"; break;
+        }
+        
+        // Add pointer, read/write bits, and row address
+        ss << " ptr=0x" << std::hex << (int)pointer;
+        ss << " rd=" << (readBit ? "1" : "0");
+        ss << " wr=" << (writeBit ? "1" : "0");
+        ss << " row=0x" << std::hex << std::setw(2) << std::setfill('0') << rowAddr;
+        ss << " base=" << std::dec << (int)baseReg;
+        
+        return ss.str();
+    }
+};
+
+#endif // PAPER_ISA_H
\ No newline at end of file
@@ -12,43 +12,76 @@ enum class Opcode : uint8_t {
     PROGRAM_LUT = 0x3,  // Program a LUT for computation
     COMPUTE     = 0x4,  // Execute computation using programmed LUT
     MOVE        = 0x5,  // Move data between cores
-    SYNC        = 0xF   // Synchronization instruction
+    REPEAT      = 0x6,  // Run the next col_addr instructions row_addr times, advancing each by its stride
+    SYNC        = 0xF   // Synchronization instruction (flag WRITE: signal the core in row_addr, READ: wait for it)
 };
 
 // Instruction format based on Section IV-D
 struct PimInstruction {
     Opcode opcode;       // 4-bit opcode
-    uint8_t core_id;     // Core pointer/ID (4-bit)
+    uint8_t core_id;     // Core pointer/ID (4-bit, extended to 8 bits)
     uint16_t row_addr;   // Memory row address (16-bit)
     uint8_t flags;       // Additional control flags (8-bit)
+    uint16_t col_addr = 0;  // Column (lane) within the row, in elements (16-bit)
+    int8_t row_stride = 0;  // In a REPEAT body, added to row_addr and col_addr at
+    int8_t col_stride = 0;  // every iteration (6-bit signed each)
     
-    // Convert instruction to binary representation
-    uint32_t toBinary() const {
-        uint32_t binary = 0;
-        binary |= (static_cast<uint32_t>(opcode) & 0xF);
-        binary |= ((static_cast<uint32_t>(core_id) & 0xF) << 4);
-        binary |= ((static_cast<uint32_t>(row_addr) & 0xFFFF) << 8);
-        binary |= ((static_cast<uint32_t>(flags) & 0xFF) << 24);
+    // Convert instruction to binary representation; the column extends the
+    // 32-bit word of Section IV-D into bits 32-47, the core ID's upper four
+    // bits go to bits 48-51, and the strides to bits 52-57 and 58-63
+    uint64_t toBinary() const {
+        uint64_t binary = 0;
+        binary |= (static_cast<uint64_t>(opcode) & 0xF);
+        binary |= ((static_cast<uint64_t>(core_id) & 0xF) << 4);
+        binary |= ((static_cast<uint64_t>(row_addr) & 0xFFFF) << 8);
+        binary |= ((static_cast<uint64_t>(flags) & 0xFF) << 24);
+        binary |= ((static_cast<uint64_t>(col_addr) & 0xFFFF) << 32);
+        binary |= ((static_cast<uint64_t>(core_id) >> 4 & 0xF) << 48);
+        binary |= ((static_cast<uint64_t>(row_stride) & 0x3F) << 52);
+        binary |= ((static_cast<uint64_t>(col_stride) & 0x3F) << 58);
         return binary;
     }
     
-    // Convert instruction to human-readable format
-    std::string toString() const {
-        std::string result;
+    // Convert a binary representation back into an instruction
+    static PimInstruction fromBinary(uint64_t binary) {
+        PimInstruction inst;
+        inst.opcode = static_cast<Opcode>(binary & 0xF);
+        inst.core_id = static_cast<uint8_t>((binary >> 4 & 0xF) | (binary >> 48 & 0xF) << 4);
+        inst.row_addr = static_cast<uint16_t>(binary >> 8);
+        inst.flags = static_cast<uint8_t>(binary >> 24);
+        inst.col_addr = static_cast<uint16_t>(binary >> 32);
+        
+        // The strides are sign-extended from 6 bits
+        inst.row_stride = static_cast<int8_t>((binary >> 52 & 0x3F) ^ 0x20) - 0x20;
+        inst.col_stride = static_cast<int8_t>((binary >> 58 & 0x3F) ^ 0x20) - 0x20;
+        return inst;
+    }
+    
+    // Name of the opcode
+    const char* mnemonic() const {
         switch(opcode) {
-            case Opcode::NOP: result = "NOP"; break;
-            case Opcode::LOAD: result = "LOAD"; break;
-            case Opcode::STORE: result = "STORE"; break;
-            case Opcode::PROGRAM_LUT: result = "PROGRAM_LUT"; break;
-            case Opcode::COMPUTE: result = "COMPUTE"; break;
-            case Opcode::MOVE: result = "MOVE"; break;
-            case Opcode::SYNC: result = "SYNC"; break;
-            default: result = "UNKNOWN"; break;
+            case Opcode::NOP: return "NOP";
+            case Opcode::LOAD: return "LOAD";
+            case Opcode::STORE: return "STORE";
+            case Opcode::PROGRAM_LUT: return "PROGRAM_LUT";
+            case Opcode::COMPUTE: return "COMPUTE";
+            case Opcode::MOVE: return "MOVE";
+            case Opcode::REPEAT: return "REPEAT";
+            case Opcode::SYNC: return "SYNC";
+            default: return "UNKNOWN";
         }
-        
+    }
+    
+    // Convert instruction to human-readable format
+    std::string toString() const {
+        std::string result = mnemonic();
         result += " core=" + std::to_string(core_id);
         result += " row=" + std::to_string(row_addr);
         result += " flags=0x" + std::to_string(flags);
+        result += " col=" + std::to_string(col_addr);
+        if (row_stride != 0 || col_stride != 0) {
+            result += " stride=" + std::to_string(row_stride) + "," + std::to_string(col_stride);
+        }
         
         return result;
     }
@@ -59,8 +92,19 @@ namespace Flags {
     constexpr uint8_t READ = 0x01;
     constexpr uint8_t WRITE = 0x02;
     constexpr uint8_t ACCUMULATE = 0x04;
+    // With LOAD, also broadcast the value to the other cores; with MOVE READ,
+    // take the location's value as last broadcast instead of reading DRAM
     constexpr uint8_t PARALLEL = 0x08;
     constexpr uint8_t RESET = 0x10;
 }
 
+// Functions PROGRAM_LUT loads into a core's LUT, given in its flags. COMPUTE
+// combines the two operands in its core's buffer with the LUT; a single
+// operand passes through, except that MULTIPLY_BY_CONSTANT multiplies it.
+namespace LutFunction {
+    constexpr uint8_t ADD = 0;
+    constexpr uint8_t MULTIPLY = 1;
+    constexpr uint8_t MULTIPLY_BY_CONSTANT = 2;  // By the signed 16-bit value in col_addr
+}
+
 #endif // PIM_ISA_H
\ No newline at end of file
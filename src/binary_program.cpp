@@ -0,0 +1,214 @@
+#include "binary_program.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char magic[4] = {'P', 'I', 'M', 'B'};
+
+// Store and fetch little-endian values of the given number of bytes
+void put(unsigned char* bytes, uint64_t value, int count) {
+    for (int b = 0; b < count; b++) {
+        bytes[b] = static_cast<unsigned char>(value >> (8 * b));
+    }
+}
+
+uint64_t get(const unsigned char* bytes, int count) {
+    uint64_t value = 0;
+    for (int b = 0; b < count; b++) {
+        value |= static_cast<uint64_t>(bytes[b]) << (8 * b);
+    }
+    return value;
+}
+
+} // namespace
+
+void BinaryProgramHeader::setTarget(const TargetConfig& target) {
+    rowsPerSubarray = target.rowsPerSubarray;
+    rowBufferBytes = target.rowBufferBytes;
+    workingSetRows = target.workingSetRows;
+    cores = target.cores;
+    loadLatency = target.loadLatency;
+    storeLatency = target.storeLatency;
+    lutLatency = target.lutLatency;
+    computeLatency = target.computeLatency;
+    moveLatency = target.moveLatency;
+    syncLatency = target.syncLatency;
+    busWidth = target.busWidth;
+    for (int matrix = 0; matrix < 3; matrix++) {
+        layouts[matrix] = target.layouts[matrix];
+    }
+}
+
+void BinaryProgramHeader::encode(unsigned char* bytes) const {
+    std::memset(bytes, 0, size);
+    std::memcpy(bytes, magic, sizeof(magic));
+    put(bytes + 4, version, 2);
+    put(bytes + 6, wordBytes, 1);
+    put(bytes + 7, static_cast<int>(encoding), 1);
+    put(bytes + 8, count, 8);
+    const int fields[] = {rowsPerSubarray, rowBufferBytes, workingSetRows, cores, loadLatency, storeLatency,
+                          lutLatency, computeLatency, moveLatency, syncLatency, busWidth};
+    for (int f = 0; f < 11; f++) {
+        put(bytes + 16 + 4 * f, fields[f], 4);
+    }
+    for (int matrix = 0; matrix < 3; matrix++) {
+        put(bytes + 60 + 4 * matrix, static_cast<int>(layouts[matrix].kind), 1);
+        put(bytes + 62 + 4 * matrix, layouts[matrix].blockSize, 2);
+    }
+}
+
+bool BinaryProgramHeader::decode(const unsigned char* bytes, size_t length) {
+    if (length < size || std::memcmp(bytes, magic, sizeof(magic)) != 0) {
+        std::cerr << "Not a binary PIM program" << std::endl;
+        return false;
+    }
+    if (get(bytes + 4, 2) != version) {
+        std::cerr << "Unsupported binary program version " << get(bytes + 4, 2) << std::endl;
+        return false;
+    }
+    wordBytes = get(bytes + 6, 1);
+    encoding = static_cast<Encoding>(get(bytes + 7, 1));
+    if (encoding == Encoding::PIM ? wordBytes != 4 && wordBytes != 8 : encoding != Encoding::PAPER || wordBytes != 3) {
+        std::cerr << "Unsupported instruction encoding " << get(bytes + 7, 1) << " with words of " << wordBytes
+                  << " bytes" << std::endl;
+        return false;
+    }
+    count = get(bytes + 8, 8);
+    int* fields[] = {&rowsPerSubarray, &rowBufferBytes, &workingSetRows, &cores, &loadLatency, &storeLatency,
+                     &lutLatency, &computeLatency, &moveLatency, &syncLatency, &busWidth};
+    for (int f = 0; f < 11; f++) {
+        *fields[f] = static_cast<int32_t>(get(bytes + 16 + 4 * f, 4));
+    }
+    for (int matrix = 0; matrix < 3; matrix++) {
+        layouts[matrix].kind = static_cast<DataLayout::Kind>(get(bytes + 60 + 4 * matrix, 1));
+        layouts[matrix].blockSize = get(bytes + 62 + 4 * matrix, 2);
+    }
+    return true;
+}
+
+int BinaryProgramHeader::wordBytesFor(const std::vector<PimInstruction>& instructions) {
+    for (const auto& inst : instructions) {
+        if (inst.toBinary() >> 32 != 0) {
+            return 8;
+        }
+    }
+    return 4;
+}
+
+BinarySink::BinarySink(std::ostream& out, const BinaryProgramHeader& header, size_t chunkSize)
+    : out(out), header(header), chunkSize(chunkSize > 0 ? chunkSize : 1) {
+    this->header.count = 0;
+    chunk.reserve(this->chunkSize * header.wordBytes);
+    
+    // The header is written again with the count at the end
+    start = out.tellp();
+    unsigned char bytes[BinaryProgramHeader::size];
+    this->header.encode(bytes);
+    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+void BinarySink::emit(const PimInstruction& inst) {
+    emitWord(inst.toBinary());
+}
+
+void BinarySink::emitWord(uint64_t word) {
+    size_t offset = chunk.size();
+    chunk.resize(offset + header.wordBytes);
+    put(chunk.data() + offset, word, header.wordBytes);
+    header.count++;
+    if (chunk.size() == chunkSize * header.wordBytes) {
+        flush();
+    }
+}
+
+bool BinarySink::finish() {
+    flush();
+    std::streampos end = out.tellp();
+    unsigned char bytes[BinaryProgramHeader::size];
+    header.encode(bytes);
+    out.seekp(start);
+    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    out.seekp(end);
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+long BinarySink::getCount() const {
+    return header.count;
+}
+
+void BinarySink::flush() {
+    out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    chunk.clear();
+}
+
+MappedProgram::~MappedProgram() {
+    if (mapping != nullptr) {
+        munmap(mapping, length);
+    }
+}
+
+bool MappedProgram::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open binary program: " << filename << std::endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(BinaryProgramHeader::size)) {
+        std::cerr << filename << ": too short for a binary program" << std::endl;
+        close(fd);
+        return false;
+    }
+    
+    // The mapping stays valid after the descriptor is closed
+    length = status.st_size;
+    mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map binary program: " << filename << std::endl;
+        mapping = nullptr;
+        return false;
+    }
+    
+    const unsigned char* bytes = static_cast<const unsigned char*>(mapping);
+    if (!header.decode(bytes, length)) {
+        return false;
+    }
+    if (header.count > (length - BinaryProgramHeader::size) / header.wordBytes) {
+        std::cerr << filename << ": " << header.count << " instructions do not fit in the file" << std::endl;
+        return false;
+    }
+    words = bytes + BinaryProgramHeader::size;
+    madvise(mapping, length, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool MappedProgram::isBinaryProgram(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char start[sizeof(magic)] = {};
+    file.read(start, sizeof(start));
+    return file && std::memcmp(start, magic, sizeof(magic)) == 0;
+}
+
+const BinaryProgramHeader& MappedProgram::getHeader() const {
+    return header;
+}
+
+size_t MappedProgram::size() const {
+    return words != nullptr ? header.count : 0;
+}
+
+uint64_t MappedProgram::word(size_t index) const {
+    return get(words + index * header.wordBytes, header.wordBytes);
+}
+
+PimInstruction MappedProgram::operator[](size_t index) const {
+    return PimInstruction::fromBinary(word(index));
+}
\ No newline at end of file
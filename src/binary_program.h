@@ -0,0 +1,114 @@
+#ifndef BINARY_PROGRAM_H
+#define BINARY_PROGRAM_H
+
+#include "instruction_sink.h"
+#include "target_config.h"
+#include "../include/pim_isa.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Header of a binary program: the target the program was generated for, and
+// the encoding, size and number of the instruction words after it. Fields
+// are little-endian at fixed offsets: "PIMB" at 0, the version (16-bit) at 4,
+// the word size in bytes (8-bit) at 6, the encoding (8-bit) at 7, the count
+// (64-bit) at 8, the target's
+// integers (32-bit each, in the order below) from 16, and at 60 the layouts
+// of A, B and C, 4 bytes each: the kind (8-bit), a pad byte and the block
+// edge (16-bit). Bytes 72 to 80 are reserved.
+struct BinaryProgramHeader {
+    enum class Encoding {
+        PIM,    // PimInstruction words
+        PAPER   // 24-bit PaperISAInstruction words
+    };
+    
+    Encoding encoding = Encoding::PIM;
+    int wordBytes = 8;   // 4 when every instruction fits the 32-bit word of Section IV-D, 3 for the paper's
+    uint64_t count = 0;
+    int rowsPerSubarray = 0;
+    int rowBufferBytes = 0;
+    int workingSetRows = 0;
+    int cores = 0;
+    int loadLatency = 0;
+    int storeLatency = 0;
+    int lutLatency = 0;
+    int computeLatency = 0;
+    int moveLatency = 0;
+    int syncLatency = 0;
+    int busWidth = 0;
+    DataLayout layouts[3];
+    
+    static constexpr size_t size = 80;
+    static constexpr int version = 1;
+    
+    // Describe a target
+    void setTarget(const TargetConfig& target);
+    
+    // Write the header into size bytes, or read it back; reading fails on a
+    // file that is not a binary program
+    void encode(unsigned char* bytes) const;
+    bool decode(const unsigned char* bytes, size_t length);
+    
+    // Smallest word that holds every instruction
+    static int wordBytesFor(const std::vector<PimInstruction>& instructions);
+};
+
+// Writes instructions into a binary program, a chunk at a time; the count
+// in the header is filled in when done, so the stream must be seekable
+class BinarySink : public InstructionSink {
+public:
+    BinarySink(std::ostream& out, const BinaryProgramHeader& header, size_t chunkSize = 4096);
+    
+    void emit(const PimInstruction& inst) override;
+    bool finish() override;
+    
+    // Write an instruction word already encoded
+    void emitWord(uint64_t word);
+    
+    // Get the number of instructions written so far
+    long getCount() const;
+    
+private:
+    std::ostream& out;
+    BinaryProgramHeader header;
+    std::vector<unsigned char> chunk;
+    size_t chunkSize;
+    std::streampos start;
+    
+    // Write the buffered chunk
+    void flush();
+};
+
+// A binary program mapped into memory. Instructions are decoded from the
+// mapped words when asked for, without reading or copying the file.
+class MappedProgram {
+public:
+    MappedProgram() = default;
+    MappedProgram(const MappedProgram&) = delete;
+    MappedProgram& operator=(const MappedProgram&) = delete;
+    ~MappedProgram();
+    
+    // Map a binary program; fails if the file is not one or is cut short
+    bool open(const std::string& filename);
+    
+    // Whether a file starts like a binary program
+    static bool isBinaryProgram(const std::string& filename);
+    
+    // Get the header
+    const BinaryProgramHeader& getHeader() const;
+    
+    // Get the number of instructions, the word of one of them, and one of
+    // them decoded from PIM ISA words
+    size_t size() const;
+    uint64_t word(size_t index) const;
+    PimInstruction operator[](size_t index) const;
+    
+private:
+    BinaryProgramHeader header;
+    void* mapping = nullptr;
+    size_t length = 0;
+    const unsigned char* words = nullptr;
+};
+
+#endif // BINARY_PROGRAM_H
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "constant_matrix.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+bool ConstantMatrix::loadFromFile(const std::string& filename, int rows, int cols, int elementSize) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open constant matrix: " << filename << std::endl;
+        return false;
+    }
+    if (elementSize < 1 || elementSize > 8) {
+        std::cerr << "Unsupported element size for a constant matrix: " << elementSize << std::endl;
+        return false;
+    }
+    
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t expected = static_cast<size_t>(rows) * cols * elementSize;
+    if (bytes.size() != expected) {
+        std::cerr << filename << ": expected " << expected << " bytes for " << rows << "x" << cols
+                  << " elements of " << elementSize << " bytes, found " << bytes.size() << std::endl;
+        return false;
+    }
+    
+    this->rows = rows;
+    this->cols = cols;
+    values.assign(static_cast<size_t>(rows) * cols, 0);
+    for (size_t i = 0; i < values.size(); i++) {
+        // Assemble the element and extend its sign
+        uint64_t element = 0;
+        for (int b = 0; b < elementSize; b++) {
+            element |= static_cast<uint64_t>(bytes[i * elementSize + b]) << (8 * b);
+        }
+        int64_t value = static_cast<int64_t>(element << (64 - 8 * elementSize)) >> (64 - 8 * elementSize);
+        if (value < minValue || value > maxValue) {
+            std::cerr << filename << ": element " << i / cols << "," << i % cols << " (" << value
+                      << ") does not fit a 16-bit LUT constant" << std::endl;
+            return false;
+        }
+        values[i] = static_cast<int>(value);
+    }
+    return true;
+}
+
+int ConstantMatrix::value(int row, int col) const {
+    if (row < 0 || row >= rows || col < 0 || col >= cols) {
+        std::cerr << "Constant matrix element out of range: " << row << "," << col << std::endl;
+        return 0;
+    }
+    return values[static_cast<size_t>(row) * cols + col];
+}
+
+int ConstantMatrix::distinctValues() const {
+    std::vector<int> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    return std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+}
\ No newline at end of file
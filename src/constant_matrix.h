@@ -0,0 +1,32 @@
+#ifndef CONSTANT_MATRIX_H
+#define CONSTANT_MATRIX_H
+
+#include <string>
+#include <vector>
+
+// Values of a matrix known at compile time, such as the weights of an
+// inference kernel. A multiply by one of them can use a LUT programmed for
+// that value, so the LUT holds a 16-bit constant and every value must fit.
+class ConstantMatrix {
+public:
+    // Read rows x cols signed little-endian integers of elementSize bytes,
+    // row by row; the file must hold exactly that many
+    bool loadFromFile(const std::string& filename, int rows, int cols, int elementSize);
+    
+    // Get an element
+    int value(int row, int col) const;
+    
+    // Get the number of distinct values
+    int distinctValues() const;
+    
+    // Smallest and largest value a LUT constant can take
+    static constexpr int minValue = -32768;
+    static constexpr int maxValue = 32767;
+    
+private:
+    int rows = 0;
+    int cols = 0;
+    std::vector<int> values;
+};
+
+#endif // CONSTANT_MATRIX_H
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "data_layout.h"
+#include <cstdlib>
+
+bool DataLayout::parse(const std::string& text) {
+    std::string name = text.substr(0, text.find(':'));
+    if (name == "row") {
+        kind = Kind::ROW_MAJOR;
+    } else if (name == "column") {
+        kind = Kind::COLUMN_MAJOR;
+    } else if (name == "blocked") {
+        kind = Kind::BLOCKED;
+    } else if (name == "morton") {
+        kind = Kind::MORTON;
+    } else {
+        return false;
+    }
+    
+    // Only blocked layouts take a block edge
+    blockSize = 0;
+    if (name.size() < text.size()) {
+        if (kind != Kind::BLOCKED) {
+            return false;
+        }
+        char* end;
+        long edge = std::strtol(text.c_str() + name.size() + 1, &end, 10);
+        if (*end != '\0' || edge <= 0) {
+            return false;
+        }
+        blockSize = static_cast<int>(edge);
+    }
+    return true;
+}
+
+std::string DataLayout::toString() const {
+    switch (kind) {
+        case Kind::ROW_MAJOR:
+            return "row";
+        case Kind::COLUMN_MAJOR:
+            return "column";
+        case Kind::BLOCKED:
+            return blockSize > 0 ? "blocked:" + std::to_string(blockSize) : "blocked";
+        case Kind::MORTON:
+            return "morton";
+        default:
+            return "unknown";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef DATA_LAYOUT_H
+#define DATA_LAYOUT_H
+
+#include <string>
+
+// Order in which the elements of a matrix are laid out in DRAM rows
+struct DataLayout {
+    enum class Kind {
+        ROW_MAJOR,     // Each matrix row starts a new DRAM row
+        COLUMN_MAJOR,  // Each matrix column starts a new DRAM row (transposed)
+        BLOCKED,       // Square blocks, each starting a new DRAM row
+        MORTON         // Z-order curve, so a DRAM row holds an aligned 2D block
+    };
+    
+    Kind kind = Kind::ROW_MAJOR;
+    int blockSize = 0;  // Edge of a BLOCKED block; 0 picks the largest that fits a row
+    
+    // Parse "row", "column", "blocked", "blocked:<edge>" or "morton"
+    bool parse(const std::string& text);
+    
+    // Get the name of the layout as accepted by parse
+    std::string toString() const;
+};
+
+#endif // DATA_LAYOUT_H
\ No newline at end of file
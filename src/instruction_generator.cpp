@@ -1,207 +1,902 @@
 #include "instruction_generator.h"
 #include <iostream>
-#include <regex>
+#include <algorithm>
+#include <thread>
 
-InstructionGenerator::InstructionGenerator(const std::vector<ThreeAddressInst>& code,
+InstructionGenerator::InstructionGenerator(const LoopNest& nest,
                                            const std::vector<Loop>& loops,
                                            MemoryMapper& memoryMapper)
-    : code(code), loops(loops), memoryMapper(memoryMapper) {
+    : nest(nest), loops(loops), memoryMapper(memoryMapper), coreAssignment(target.distribution, target.cores) {
 }
 
 std::vector<PimInstruction> InstructionGenerator::generateInstructions() {
     std::vector<PimInstruction> instructions;
+    BufferSink bufferSink(instructions);
+    generateInstructions(bufferSink);
+    return instructions;
+}
+
+void InstructionGenerator::generateInstructions(InstructionSink& sink) {
+    if (loopOrder.empty()) {
+        for (int level = 0; level < loops.size(); level++) {
+            loopOrder.push_back(level);
+        }
+    }
     
-    // Extract parallelizable loops
-    std::vector<Loop> parallelizableLoops;
-    for (const auto& loop : loops) {
-        if (loop.isParallelizable) {
-            parallelizableLoops.push_back(loop);
+    // The two outermost parallelizable loops in the order (i and j for matrix
+    // multiplication) are distributed across cores. A sequential loop between
+    // them breaks up the runs a core lowers, so the second is only reached for
+    // across one when the first has fewer iterations than there are cores.
+    // Sequential loops run on every core, and the SYNC pairs order the
+    // iterations they carry.
+    distributedLoops.clear();
+    bool sequentialBetween = false;
+    for (int level : loopOrder) {
+        const Loop& loop = loops[level];
+        if (!loop.isParallelizable) {
+            sequentialBetween = !distributedLoops.empty();
+        } else if (distributedLoops.empty()) {
+            distributedLoops.push_back(level);
+        } else if (distributedLoops.size() < 2) {
+            const Loop& first = loops[distributedLoops[0]];
+            if (!sequentialBetween || (first.upperBound - first.lowerBound) / first.step + 1 < target.cores) {
+                distributedLoops.push_back(level);
+            }
         }
     }
     
-    // For matrix multiplication, we can parallelize the i and j loops
-    // We'll distribute the work across cores based on the (i,j) pairs
+    // Temporaries get a slot when defined and give it back after their last use
+    LivenessAnalyzer liveness(nest);
+    liveness.analyze();
+    liveRanges = liveness.getLiveRanges();
+    liveTemps.assign(liveRanges.size(), {});
+    
+    distributeWork();
+    
+    // Every core allocates temporaries from its own slots; the constants get
+    // theirs up front, so lowering only reads them
+    memoryMapper.setCores(target.cores);
+    for (int i = 0; i < nest.body.size(); i++) {
+        const auto& inst = nest.body[i];
+        bool srcIsZero = inst.op == ThreeAddressInst::OpType::MOVE &&
+                         inst.src1.kind == Operand::Kind::CONSTANT && inst.src1.id == 0;
+        if (inst.src1.kind == Operand::Kind::CONSTANT && !srcIsZero) {
+            memoryMapper.mapConstant(inst.src1.id);
+        }
+        if (inst.src2.kind == Operand::Kind::CONSTANT) {
+            memoryMapper.mapConstant(inst.src2.id);
+        }
+    }
     
-    // Process the three-address code
-    for (int i = 0; i <= 2; i++) {  // i loop (0-2 for 3x3 example)
-        for (int j = 0; j <= 2; j++) {  // j loop (0-2 for 3x3 example)
-            // Assign a core ID for this (i,j) pair
-            int coreId = assignCoreId(i, j);
+    // No core's LUT is programmed yet
+    coreLut.assign(target.cores, {-1, 0});
+    lutPrograms = 0;
+    lutProgramsSkipped = 0;
+    constantLoadsSkipped = 0;
+    zeroProductsSkipped = 0;
+    findMultiplyGroup();
+    
+    workerCount = canLowerCoresApart() ? std::max(1, std::min(jobs, target.cores)) : 1;
+    if (workerCount == 1) {
+        this->sink = &sink;
+        generateAll();
+        this->sink = nullptr;
+        return;
+    }
+    
+    // Each worker is a copy of the generator lowering the points of its own
+    // cores into a buffer, and noting where every point's instructions end
+    std::vector<InstructionGenerator> workers(workerCount, *this);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workerCount; w++) {
+        threads.emplace_back([&workers, w]() {
+            InstructionGenerator& generator = workers[w];
+            BufferSink bufferSink(generator.workerInstructions);
+            generator.worker = w;
+            generator.sink = &bufferSink;
+            generator.generateAll();
+            generator.sink = nullptr;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    // Points are numbered in walk order, so merging the workers' points by
+    // number gives the serial order
+    std::vector<size_t> nextPoint(workerCount, 0);
+    std::vector<size_t> emitted(workerCount, 0);
+    while (true) {
+        int next = -1;
+        for (int w = 0; w < workerCount; w++) {
+            if (nextPoint[w] < workers[w].pointEnds.size() &&
+                (next < 0 || workers[w].pointEnds[nextPoint[w]].first < workers[next].pointEnds[nextPoint[next]].first)) {
+                next = w;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        size_t end = workers[next].pointEnds[nextPoint[next]++].second;
+        for (; emitted[next] < end; emitted[next]++) {
+            sink.emit(workers[next].workerInstructions[emitted[next]]);
+        }
+    }
+    for (const auto& generator : workers) {
+        lutPrograms += generator.lutPrograms;
+        lutProgramsSkipped += generator.lutProgramsSkipped;
+        constantLoadsSkipped += generator.constantLoadsSkipped;
+        zeroProductsSkipped += generator.zeroProductsSkipped;
+    }
+}
+
+bool InstructionGenerator::setConstantMatrix(int matrix, const ConstantMatrix& values) {
+    auto isMatrix = [&](const Operand& operand) {
+        return operand.kind == Operand::Kind::ARRAY && nest.accesses[operand.id].array == matrix;
+    };
+    
+    // The matrix may only be loaded into temporaries
+    std::vector<bool> loads(nest.body.size(), false);
+    std::vector<int> tempAccess(nest.tempCount, -1);
+    for (int i = 0; i < nest.body.size(); i++) {
+        const auto& inst = nest.body[i];
+        if (inst.op == ThreeAddressInst::OpType::LOAD && isMatrix(inst.src1) && inst.dest.kind == Operand::Kind::TEMP) {
+            loads[i] = true;
+            tempAccess[inst.dest.id] = inst.src1.id;
+        } else if (isMatrix(inst.dest) || isMatrix(inst.src1) || isMatrix(inst.src2)) {
+            std::cerr << "Constant matrix is not only loaded: " << nest.toString(inst) << std::endl;
+            return false;
+        }
+    }
+    
+    // and what it loads may only be multiplied by a value that is not constant
+    for (const auto& inst : nest.body) {
+        for (const Operand* operand : {&inst.src1, &inst.src2}) {
+            if (operand->kind != Operand::Kind::TEMP || tempAccess[operand->id] < 0) {
+                continue;
+            }
+            const Operand& other = operand == &inst.src1 ? inst.src2 : inst.src1;
+            if (inst.op != ThreeAddressInst::OpType::MULTIPLY || other.kind == Operand::Kind::CONSTANT ||
+                (other.kind == Operand::Kind::TEMP && tempAccess[other.id] >= 0)) {
+                std::cerr << "Constant matrix element is not a factor: " << nest.toString(inst) << std::endl;
+                return false;
+            }
+        }
+    }
+    
+    constantMatrix = matrix;
+    constantValues = &values;
+    constantLoad = loads;
+    constantTempAccess = tempAccess;
+    return true;
+}
+
+long InstructionGenerator::getConstantLoadsSkipped() const {
+    return constantLoadsSkipped;
+}
+
+long InstructionGenerator::getZeroProductsSkipped() const {
+    return zeroProductsSkipped;
+}
+
+void InstructionGenerator::setJobs(int jobs) {
+    this->jobs = std::max(1, jobs);
+}
+
+int InstructionGenerator::getWorkerCount() const {
+    return workerCount;
+}
+
+bool InstructionGenerator::canLowerCoresApart() const {
+    // A split reduction lowers a point on several cores
+    if (splitLevel >= 0 || distributedLoops.empty()) {
+        return false;
+    }
+    
+    // Every instance of a temporary must belong to one core, so the loops
+    // enclosing its definition must include the parallel ones
+    for (const auto& range : liveRanges) {
+        for (int level : distributedLoops) {
+            if (level >= range.defDepth) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void InstructionGenerator::generateAll() {
+    pointCount = 0;
+    
+    // Walk the iteration space tile by tile, lowering the symbolic body at every point
+    std::vector<int> tileStarts(loops.size());
+    std::vector<int> iterators(loops.size());
+    generateLevel(0, tileStarts, iterators);
+}
+
+void InstructionGenerator::setLoopOrder(const std::vector<int>& order) {
+    loopOrder = order;
+}
+
+bool InstructionGenerator::fuseMultiplyAccumulate(const Reduction& reduction) {
+    const auto& update = nest.body[reduction.update];
+    if (reduction.op != ThreeAddressInst::OpType::ADD || update.op != ThreeAddressInst::OpType::ADD) {
+        std::cerr << "Only sums can be fused into multiply-accumulates" << std::endl;
+        return false;
+    }
+    
+    // The value added is the operand not loaded from the accumulator
+    const auto& accumulated = nest.body[reduction.load].dest;
+    const Operand& value = update.src1.kind == accumulated.kind && update.src1.id == accumulated.id ? update.src2
+                                                                                                      : update.src1;
+    int multiply = -1;
+    int uses = 0;
+    for (int i = 0; i < nest.body.size(); i++) {
+        const auto& inst = nest.body[i];
+        if (inst.dest.kind == Operand::Kind::TEMP && value.kind == Operand::Kind::TEMP && inst.dest.id == value.id) {
+            multiply = i;
+        }
+        for (const Operand* operand : {&inst.src1, &inst.src2}) {
+            if (operand->kind == Operand::Kind::TEMP && value.kind == Operand::Kind::TEMP && operand->id == value.id) {
+                uses++;
+            }
+        }
+    }
+    if (multiply < 0 || nest.body[multiply].op != ThreeAddressInst::OpType::MULTIPLY || uses != 1 ||
+        nest.body[multiply].depth != update.depth) {
+        std::cerr << "The reduction does not add a product, so it cannot be fused" << std::endl;
+        return false;
+    }
+    
+    macMultiply = multiply;
+    macLoad = reduction.load;
+    macUpdate = reduction.update;
+    macStore = reduction.store;
+    macAccess = reduction.access;
+    macLoops = reduction.loops;
+    return true;
+}
+
+void InstructionGenerator::setTarget(const TargetConfig& target) {
+    this->target = target;
+    coreAssignment = CoreAssignment(target.distribution, target.cores);
+}
+
+const std::vector<long>& InstructionGenerator::getCoreLoads() const {
+    return coreAssignment.getCoreLoads();
+}
+
+std::vector<int> InstructionGenerator::getDistributedLoops() const {
+    return distributedLoops;
+}
+
+void InstructionGenerator::setGroupMultiplies(bool enable) {
+    groupMultiplies = enable;
+}
+
+long InstructionGenerator::getLutPrograms() const {
+    return lutPrograms;
+}
+
+long InstructionGenerator::getLutProgramsSkipped() const {
+    return lutProgramsSkipped;
+}
+
+bool InstructionGenerator::splitReduction(const Reduction& reduction, int ways) {
+    if (reduction.loops.size() != 1 || reduction.op != ThreeAddressInst::OpType::ADD) {
+        std::cerr << "Only sums over a single loop can be split across cores" << std::endl;
+        return false;
+    }
+    
+    const Loop& loop = loops[reduction.loops[0]];
+    int tripCount = (loop.upperBound - loop.lowerBound) / loop.step + 1;
+    splitAccess = reduction.access;
+    splitStore = reduction.store;
+    splitLevel = reduction.loops[0];
+    splitChunkSize = (tripCount + ways - 1) / ways;
+    splitWays = (tripCount + splitChunkSize - 1) / splitChunkSize;
+    return true;
+}
+
+void InstructionGenerator::generateLevel(int level, std::vector<int>& tileStarts, std::vector<int>& iterators) {
+    int depth = loops.size();
+    
+    // Tile loops come first, then the point loops within the current tile,
+    // both in the chosen loop order. Iterations are counted rather than
+    // compared against the bounds, so loops counting down walk the same way.
+    if (level < depth) {
+        int index = loopOrder[level];
+        const Loop& loop = loops[index];
+        int tripCount = (loop.upperBound - loop.lowerBound) / loop.step + 1;
+        for (int first = 0; first < tripCount; first += loop.tileSize) {
+            tileStarts[index] = loop.lowerBound + first * loop.step;
+            generateLevel(level + 1, tileStarts, iterators);
+        }
+    } else if (level == depth && groupPass == 0 && groupMultiplies &&
+               std::find(multiplyGroup.begin(), multiplyGroup.end(), true) != multiplyGroup.end()) {
+        // Walk the tile twice: the multiplies first, then everything else
+        for (groupPass = 1; groupPass <= 2; groupPass++) {
+            generateLevel(level, tileStarts, iterators);
+        }
+        groupPass = 0;
+    } else if (level < 2 * depth) {
+        int index = loopOrder[level - depth];
+        const Loop& loop = loops[index];
+        int count = std::min(loop.tileSize, (loop.upperBound - tileStarts[index]) / loop.step + 1);
+        for (int t = 0; t < count; t++) {
+            iterators[index] = tileStarts[index] + t * loop.step;
+            generateLevel(level + 1, tileStarts, iterators);
+        }
+    } else {
+        generatePoint(iterators);
+    }
+}
+
+void InstructionGenerator::generatePoint(const std::vector<int>& iterators) {
+    // Only iterations of parallel loops may be spread over cores; a tile of
+    // them goes to one core so it can reuse the rows the tile activates
+    int first = distributedLoops.size() > 0 ? distributedLoops[0] : 0;
+    int second = distributedLoops.size() > 1 ? distributedLoops[1] : 0;
+    int coreId = assignCoreId(distributedLoops.size() > 0 ? coreCoordinate(first, iterators[first]) : 0,
+                              distributedLoops.size() > 1 ? coreCoordinate(second, iterators[second]) : 0);
+    
+    // A worker only lowers the points of its own cores
+    long point = pointCount++;
+    if (worker >= 0) {
+        if (coreId % workerCount != worker) {
+            return;
+        }
+        lowerPoint(iterators, coreId);
+        pointEnds.emplace_back(point, workerInstructions.size());
+        return;
+    }
+    lowerPoint(iterators, coreId);
+}
+
+void InstructionGenerator::lowerPoint(const std::vector<int>& iterators, int coreId) {
+    int depth = loops.size();
+    
+    // Instructions placed before a nested loop run at its first iteration and
+    // those placed after it at its last, which keeps them in order around the
+    // loop however its iterations are tiled. firstFrom/lastFrom are the
+    // outermost levels from which every loop is at its first/last iteration.
+    int firstFrom = depth;
+    while (firstFrom > 0 && iterators[firstFrom - 1] == loops[firstFrom - 1].lowerBound) {
+        firstFrom--;
+    }
+    int lastFrom = depth;
+    while (lastFrom > 0 && isLastIteration(lastFrom - 1, iterators)) {
+        lastFrom--;
+    }
+    
+    // Iterations of a split reduction loop run on the core of their chunk
+    int chunk = 0;
+    bool chunkStart = false;
+    if (splitLevel >= 0) {
+        const Loop& loop = loops[splitLevel];
+        int index = (iterators[splitLevel] - loop.lowerBound) / loop.step;
+        chunk = index / splitChunkSize;
+        chunkStart = index % splitChunkSize == 0;
+    }
+    
+    auto generateBody = [&](int level, bool afterInner) {
+        for (int i = 0; i < nest.body.size(); i++) {
+            const auto& inst = nest.body[i];
+            if (inst.depth == level && inst.afterInner == afterInner && (groupPass == 0 || multiplyGroup[i] == (groupPass == 1))) {
+                activeChunk = splitLevel >= 0 && level > splitLevel ? chunk : 0;
+                generateForInstruction(i, iterators, chunkCore(coreId, activeChunk));
+            }
+        }
+        activeChunk = 0;
+    };
+    
+    // The first pass over a tile only lowers its multiplies
+    if (groupPass == 1) {
+        generateBody(depth, false);
+        return;
+    }
+    
+    for (int level = firstFrom; level <= depth; level++) {
+        // A chunk's partial result starts from zero
+        if (level == splitLevel + 1 && chunk > 0 && chunkStart) {
+            PimInstruction moveInst;
+            moveInst.opcode = Opcode::MOVE;
+            moveInst.core_id = chunkCore(coreId, chunk);
+            MemoryLocation partialLocation = memoryMapper.allocateTemp(chunkCore(coreId, chunk));
+            partials[partialKey(iterators, chunk)] = partialLocation;
+            moveInst.row_addr = partialLocation.row;
+            moveInst.col_addr = partialLocation.col;
+            moveInst.flags = Flags::WRITE | Flags::RESET;
+            sink->emit(moveInst);
+        }
+        generateBody(level, false);
+    }
+    for (int level = depth; level >= lastFrom; level--) {
+        // Combine the partial results once the reduction loop is done
+        if (level == splitLevel) {
+            generateReductionTree(iterators, coreId);
+        }
+        
+        generateBody(level, true);
+    }
+    
+    // Temporaries read inside a nested loop die with its last iteration
+    for (int temp = 0; temp < liveRanges.size(); temp++) {
+        if (liveRanges[temp].crossesLoop() && liveRanges[temp].defDepth >= lastFrom) {
+            releaseTemp(temp, iterators);
+        }
+    }
+}
+
+void InstructionGenerator::generateReductionTree(const std::vector<int>& iterators, int coreId) {
+    // At each level of the tree, chunk c takes in the partial result of chunk
+    // c + stride: MOVE transfers that row to c's core and COMPUTE with
+    // ACCUMULATE adds it into c's row. Chunk 0's row is the array element.
+    for (int stride = 1; stride < splitWays; stride *= 2) {
+        for (int chunk = 0; chunk + stride < splitWays; chunk += 2 * stride) {
+            int core = chunkCore(coreId, chunk);
             
-            // Initialize C[i][j] to 0
-            std::string cij = "C_" + std::to_string(i) + "_" + std::to_string(j);
-            auto initInsts = generateMoveInstructions(cij, "0", coreId);
-            instructions.insert(instructions.end(), initInsts.begin(), initInsts.end());
+            auto source = partials.find(partialKey(iterators, chunk + stride));
+            MemoryLocation sourceLocation = source->second;
+            MemoryLocation destLocation = chunk > 0 ? partials[partialKey(iterators, chunk)]
+                                                    : operandLocation(nest.body[splitStore].dest, iterators);
+            memoryMapper.releaseTemp(sourceLocation);
+            partials.erase(source);
             
-            for (int k = 0; k <= 2; k++) {  // k loop (0-2 for 3x3 example)
-                // Extract the relevant instructions for this (i,j,k) iteration
-                std::string aik = "A_" + std::to_string(i) + "_" + std::to_string(k);
-                std::string bkj = "B_" + std::to_string(k) + "_" + std::to_string(j);
-                
-                // Load A[i][k]
-                auto loadAInsts = generateLoadInstructions("t_A_" + std::to_string(i) + "_" + std::to_string(k), aik, coreId);
-                instructions.insert(instructions.end(), loadAInsts.begin(), loadAInsts.end());
-                
-                // Load B[k][j]
-                auto loadBInsts = generateLoadInstructions("t_B_" + std::to_string(k) + "_" + std::to_string(j), bkj, coreId);
-                instructions.insert(instructions.end(), loadBInsts.begin(), loadBInsts.end());
-                
-                // Multiply A[i][k] * B[k][j]
-                auto mulInsts = generateMultiplyInstructions(
-                    "t_mul_" + std::to_string(i) + "_" + std::to_string(j) + "_" + std::to_string(k),
-                    "t_A_" + std::to_string(i) + "_" + std::to_string(k),
-                    "t_B_" + std::to_string(k) + "_" + std::to_string(j),
-                    coreId
-                );
-                instructions.insert(instructions.end(), mulInsts.begin(), mulInsts.end());
-                
-                // Load current C[i][j]
-                auto loadCInsts = generateLoadInstructions("t_C_" + std::to_string(i) + "_" + std::to_string(j), cij, coreId);
-                instructions.insert(instructions.end(), loadCInsts.begin(), loadCInsts.end());
-                
-                // Add to C[i][j]
-                auto addInsts = generateAddInstructions(
-                    "t_C_new_" + std::to_string(i) + "_" + std::to_string(j),
-                    "t_C_" + std::to_string(i) + "_" + std::to_string(j),
-                    "t_mul_" + std::to_string(i) + "_" + std::to_string(j) + "_" + std::to_string(k),
-                    coreId
-                );
-                instructions.insert(instructions.end(), addInsts.begin(), addInsts.end());
-                
-                // Store back to C[i][j]
-                auto storeCInsts = generateStoreInstructions(
-                    cij,
-                    "t_C_new_" + std::to_string(i) + "_" + std::to_string(j),
-                    coreId
-                );
-                instructions.insert(instructions.end(), storeCInsts.begin(), storeCInsts.end());
+            // A single operand passes through the LUT unless it multiplies
+            // by a constant
+            if (coreLut[core].first == LutFunction::MULTIPLY_BY_CONSTANT) {
+                programLut(LutFunction::ADD, core);
             }
             
-            // Add a synchronization instruction after each (i,j) pair
-            PimInstruction syncInst;
-            syncInst.opcode = Opcode::SYNC;
-            syncInst.core_id = coreId;
-            syncInst.row_addr = 0;
-            syncInst.flags = 0;
-            instructions.push_back(syncInst);
+            PimInstruction moveInst;
+            moveInst.opcode = Opcode::MOVE;
+            moveInst.core_id = core;
+            moveInst.row_addr = sourceLocation.row;
+            moveInst.col_addr = sourceLocation.col;
+            moveInst.flags = Flags::READ;
+            sink->emit(moveInst);
+            
+            PimInstruction computeInst;
+            computeInst.opcode = Opcode::COMPUTE;
+            computeInst.core_id = core;
+            computeInst.row_addr = destLocation.row;
+            computeInst.col_addr = destLocation.col;
+            computeInst.flags = Flags::ACCUMULATE;
+            sink->emit(computeInst);
         }
     }
+}
+
+void InstructionGenerator::generateMultiplyAccumulate(const MemoryLocation& src1Location,
+                                                      const MemoryLocation& src2Location,
+                                                      const std::vector<int>& iterators, int coreId) {
+    // Chunks of a split reduction accumulate into their partial result, which
+    // starts from zero; otherwise the accumulator starts from the element
+    auto key = partialKey(iterators, activeChunk);
+    const auto& element = nest.body[macStore].dest;
+    if (activeChunk == 0 && isReductionBoundary(iterators, false)) {
+        partials[key] = memoryMapper.allocateTemp(coreId);
+        generateLoadInstructions(partials[key], operandLocation(element, iterators), coreId);
+    }
+    MemoryLocation accumulator = partials[key];
     
-    return instructions;
+    // A product by zero adds nothing
+    if (multiplyByConstant && multiplyConstant == 0) {
+        zeroProductsSkipped++;
+    } else {
+        generateMultiplyOperands(src1Location, src2Location, coreId);
+        
+        // Multiply and add the product into the accumulator
+        PimInstruction computeInst;
+        computeInst.opcode = Opcode::COMPUTE;
+        computeInst.core_id = coreId;
+        computeInst.row_addr = accumulator.row;
+        computeInst.col_addr = accumulator.col;
+        computeInst.flags = Flags::ACCUMULATE;
+        sink->emit(computeInst);
+    }
+    
+    // The element is written once its chunk of the reduction is done
+    if (activeChunk == 0 && isReductionBoundary(iterators, true)) {
+        generateStoreInstructions(operandLocation(element, iterators), accumulator, coreId);
+        memoryMapper.releaseTemp(accumulator);
+        partials.erase(key);
+    }
 }
 
-int InstructionGenerator::assignCoreId(int i, int j) {
-    // Simple assignment: (i * 3 + j) % maxCores
-    return (i * 3 + j) % maxCores;
+bool InstructionGenerator::isReductionBoundary(const std::vector<int>& iterators, bool last) const {
+    for (int level : macLoops) {
+        const Loop& loop = loops[level];
+        int index = (iterators[level] - loop.lowerBound) / loop.step;
+        bool boundary;
+        if (level == splitLevel) {
+            boundary = last ? index % splitChunkSize == splitChunkSize - 1 || isLastIteration(level, iterators)
+                            : index % splitChunkSize == 0;
+        } else {
+            boundary = last ? isLastIteration(level, iterators) : index == 0;
+        }
+        if (!boundary) {
+            return false;
+        }
+    }
+    return true;
 }
 
-std::vector<PimInstruction> InstructionGenerator::generateForInstruction(const ThreeAddressInst& inst, int coreId) {
+void InstructionGenerator::findMultiplyGroup() {
+    int depth = loops.size();
+    multiplyGroup.assign(nest.body.size(), false);
+    
+    // Arrays the body writes must not be read ahead of the writes
+    std::vector<bool> written(nest.arrays.size(), false);
+    for (const auto& inst : nest.body) {
+        if (inst.dest.kind == Operand::Kind::ARRAY) {
+            written[nest.accesses[inst.dest.id].array] = true;
+        }
+    }
+    
+    // Take each innermost multiply together with the loads defining its
+    // operands; a multiply fed by anything else stays in program order. A
+    // fused multiply-accumulate needs no adder, so it is left where it is.
+    for (int i = 0; i < nest.body.size(); i++) {
+        const auto& inst = nest.body[i];
+        if (inst.op != ThreeAddressInst::OpType::MULTIPLY || inst.depth != depth ||
+            inst.dest.kind != Operand::Kind::TEMP || i == macMultiply) {
+            continue;
+        }
+        std::vector<int> group = {i};
+        bool movable = true;
+        for (const Operand* operand : {&inst.src1, &inst.src2}) {
+            if (operand->kind != Operand::Kind::TEMP) {
+                movable = movable && operand->kind == Operand::Kind::CONSTANT;
+                continue;
+            }
+            int def = liveRanges[operand->id].def;
+            if (def < 0) {
+                movable = false;
+                break;
+            }
+            const auto& load = nest.body[def];
+            if (load.op != ThreeAddressInst::OpType::LOAD || load.depth != depth ||
+                load.src1.kind != Operand::Kind::ARRAY || written[nest.accesses[load.src1.id].array] ||
+                liveRanges[operand->id].lastUse != i) {
+                movable = false;
+                break;
+            }
+            group.push_back(def);
+        }
+        if (movable) {
+            for (int index : group) {
+                multiplyGroup[index] = true;
+            }
+        }
+    }
+}
+
+void InstructionGenerator::programLut(int function, int coreId, int constant) {
+    if (coreLut[coreId] == std::make_pair(function, constant)) {
+        lutProgramsSkipped++;
+        return;
+    }
+    coreLut[coreId] = {function, constant};
+    lutPrograms++;
+    
+    PimInstruction programLutInst;
+    programLutInst.opcode = Opcode::PROGRAM_LUT;
+    programLutInst.core_id = coreId;
+    programLutInst.row_addr = 0;  // Special row for LUT programming
+    programLutInst.col_addr = static_cast<uint16_t>(constant);
+    programLutInst.flags = function;
+    sink->emit(programLutInst);
+}
+
+int InstructionGenerator::chunkCore(int coreId, int chunk) const {
+    return (coreId + chunk) % target.cores;
+}
+
+bool InstructionGenerator::isLastIteration(int level, const std::vector<int>& iterators) const {
+    return iterators[level] == loops[level].upperBound;
+}
+
+int InstructionGenerator::coreCoordinate(int level, int value) const {
+    const Loop& loop = loops[level];
+    int tripCount = (loop.upperBound - loop.lowerBound) / loop.step + 1;
+    if (loop.tileSize >= tripCount) {
+        return (value - loop.lowerBound) / loop.step;
+    }
+    return (value - loop.lowerBound) / loop.step / loop.tileSize;
+}
+
+int InstructionGenerator::coordinateCount(int level) const {
+    const Loop& loop = loops[level];
+    int tripCount = (loop.upperBound - loop.lowerBound) / loop.step + 1;
+    if (loop.tileSize >= tripCount) {
+        return tripCount;
+    }
+    return (tripCount + loop.tileSize - 1) / loop.tileSize;
+}
+
+int InstructionGenerator::coordinateIterations(int level, int coordinate) const {
+    const Loop& loop = loops[level];
+    int tripCount = (loop.upperBound - loop.lowerBound) / loop.step + 1;
+    if (loop.tileSize >= tripCount) {
+        return 1;
+    }
+    return std::min(loop.tileSize, tripCount - coordinate * loop.tileSize);
+}
+
+long InstructionGenerator::estimateCycles(const ThreeAddressInst& inst) const {
     switch (inst.op) {
         case ThreeAddressInst::OpType::LOAD:
-            return generateLoadInstructions(inst.dest, inst.src1, coreId);
         case ThreeAddressInst::OpType::STORE:
-            return generateStoreInstructions(inst.dest, inst.src1, coreId);
+            return target.loadLatency + target.storeLatency;
         case ThreeAddressInst::OpType::ADD:
-            return generateAddInstructions(inst.dest, inst.src1, inst.src2, coreId);
         case ThreeAddressInst::OpType::MULTIPLY:
-            return generateMultiplyInstructions(inst.dest, inst.src1, inst.src2, coreId);
+            return 2 * target.loadLatency + target.computeLatency + target.storeLatency;
         case ThreeAddressInst::OpType::MOVE:
-            return generateMoveInstructions(inst.dest, inst.src1, coreId);
+            return target.moveLatency;
         default:
-            std::cerr << "Unknown instruction type" << std::endl;
-            return {};
+            return 1;
     }
 }
 
-std::vector<PimInstruction> InstructionGenerator::generateLoadInstructions(const std::string& dest, const std::string& src, int coreId) {
-    std::vector<PimInstruction> instructions;
+void InstructionGenerator::distributeWork() {
+    int first = distributedLoops.size() > 0 ? distributedLoops[0] : -1;
+    int second = distributedLoops.size() > 1 ? distributedLoops[1] : -1;
+    int rows = first >= 0 ? coordinateCount(first) : 1;
+    int cols = second >= 0 ? coordinateCount(second) : 1;
+    
+    // A body instruction runs once for every iteration of the loops around it;
+    // within a unit, the parallel loops only run the unit's iterations
+    std::vector<long> costs(static_cast<size_t>(rows) * cols, 0);
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            long cycles = 0;
+            for (const auto& inst : nest.body) {
+                long count = 1;
+                for (int level = 0; level < inst.depth; level++) {
+                    const Loop& loop = loops[level];
+                    if (level == first) {
+                        count *= coordinateIterations(level, row);
+                    } else if (level == second) {
+                        count *= coordinateIterations(level, col);
+                    } else {
+                        count *= (loop.upperBound - loop.lowerBound) / loop.step + 1;
+                    }
+                }
+                cycles += count * estimateCycles(inst);
+            }
+            costs[row * cols + col] = cycles;
+        }
+    }
+    coreAssignment.assign(rows, cols, costs);
+}
+
+int InstructionGenerator::assignCoreId(int i, int j) {
+    return coreAssignment.coreOf(i, j);
+}
+
+void InstructionGenerator::generateForInstruction(int index, const std::vector<int>& iterators, int coreId) {
+    const auto& inst = nest.body[index];
+    
+    // The accumulator's load, add and store are done by the fused multiply
+    if (index == macLoad || index == macUpdate || index == macStore) {
+        return;
+    }
+    
+    // Loads of the constant matrix are folded into the multiplies using them
+    if (constantMatrix >= 0 && constantLoad[index]) {
+        constantLoadsSkipped++;
+        return;
+    }
+    
+    // A multiply by an element of the constant matrix takes the element's
+    // value and reads only the other operand, as its first
+    multiplyByConstant = false;
+    const Operand* src1Operand = &inst.src1;
+    if (constantMatrix >= 0 && inst.op == ThreeAddressInst::OpType::MULTIPLY) {
+        for (const Operand* operand : {&inst.src1, &inst.src2}) {
+            if (operand->kind == Operand::Kind::TEMP && constantTempAccess[operand->id] >= 0) {
+                const auto& access = nest.accesses[constantTempAccess[operand->id]];
+                multiplyByConstant = true;
+                multiplyConstant = constantValues->value(access.row.evaluate(iterators), access.col.evaluate(iterators));
+                src1Operand = operand == &inst.src1 ? &inst.src2 : &inst.src1;
+            }
+        }
+    }
+    
+    // Sources are resolved first, so a temporary dying here can pass its slot
+    // on to the result. Only a MOVE of 0 resets its destination instead of
+    // reading a slot; a 0 operand of anything else is a constant like any other.
+    bool srcIsZero = inst.op == ThreeAddressInst::OpType::MOVE &&
+                     inst.src1.kind == Operand::Kind::CONSTANT && inst.src1.id == 0;
+    MemoryLocation src1 = srcIsZero ? MemoryLocation{0, 0} : operandLocation(*src1Operand, iterators);
+    MemoryLocation src2 = multiplyByConstant ? MemoryLocation{0, 0} : operandLocation(inst.src2, iterators);
+    
+    // The accumulator is taken before the operands' slots are given back, as
+    // it is written before they are read
+    if (index == macMultiply) {
+        generateMultiplyAccumulate(src1, src2, iterators, coreId);
+        releaseDeadTemps(index, iterators);
+        return;
+    }
+    releaseDeadTemps(index, iterators);
+    MemoryLocation dest = inst.dest.kind == Operand::Kind::TEMP ? defineTemp(inst.dest, iterators, coreId)
+                                                                : operandLocation(inst.dest, iterators);
     
-    // Map source variable to DRAM row
-    uint16_t srcRow = memoryMapper.mapVariableToRow(src);
+    // A result nobody reads is dead right away
+    if (inst.dest.kind == Operand::Kind::TEMP && liveRanges[inst.dest.id].lastUse == index) {
+        releaseTemp(inst.dest.id, iterators);
+    }
     
-    // Map destination variable to DRAM row
-    uint16_t destRow = memoryMapper.mapVariableToRow(dest);
+    switch (inst.op) {
+        case ThreeAddressInst::OpType::LOAD:
+            generateLoadInstructions(dest, src1, coreId);
+            break;
+        case ThreeAddressInst::OpType::STORE:
+            generateStoreInstructions(dest, src1, coreId);
+            break;
+        case ThreeAddressInst::OpType::ADD:
+            generateAddInstructions(dest, src1, src2, coreId);
+            break;
+        case ThreeAddressInst::OpType::MULTIPLY:
+            generateMultiplyInstructions(dest, src1, src2, coreId);
+            break;
+        case ThreeAddressInst::OpType::MOVE:
+            generateMoveInstructions(dest, src1, srcIsZero, coreId);
+            break;
+        default:
+            std::cerr << "Unknown instruction type" << std::endl;
+            break;
+    }
+}
+
+MemoryLocation InstructionGenerator::operandLocation(const Operand& operand, const std::vector<int>& iterators) {
+    switch (operand.kind) {
+        case Operand::Kind::ARRAY: {
+            // Chunks of a split reduction accumulate into their partial result
+            if (operand.id == splitAccess && activeChunk > 0) {
+                return partials[partialKey(iterators, activeChunk)];
+            }
+            
+            const auto& access = nest.accesses[operand.id];
+            return memoryMapper.getMatrixElementLocation(access.array, access.row.evaluate(iterators),
+                                                         access.col.evaluate(iterators));
+        }
+        case Operand::Kind::TEMP: {
+            // The instance defined for the loops enclosing the definition
+            const auto& instances = liveTemps[operand.id];
+            auto it = instances.find(tempPrefix(operand.id, iterators));
+            if (it != instances.end()) {
+                return it->second;
+            }
+            std::cerr << "Temporary " << nest.symbols.name(operand.symbol) << " used before its definition" << std::endl;
+            return defineTemp(operand, iterators, 0);
+        }
+        case Operand::Kind::CONSTANT:
+            return memoryMapper.constantLocation(operand.id);
+        default:
+            return MemoryLocation{0, 0};
+    }
+}
+
+MemoryLocation InstructionGenerator::defineTemp(const Operand& operand, const std::vector<int>& iterators, int coreId) {
+    const auto& range = liveRanges[operand.id];
+    auto& instances = liveTemps[operand.id];
+    
+    // Only the last instance of a temporary read after its loop survives
+    if (range.escapesLoop()) {
+        for (auto it = instances.begin(); it != instances.end();) {
+            if (std::equal(it->first.begin(), it->first.begin() + range.useDepth, iterators.begin())) {
+                memoryMapper.releaseTemp(it->second);
+                it = instances.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
     
+    MemoryLocation location = memoryMapper.allocateTemp(coreId);
+    instances[tempPrefix(operand.id, iterators)] = location;
+    return location;
+}
+
+std::vector<int> InstructionGenerator::tempPrefix(int temp, const std::vector<int>& iterators) const {
+    return std::vector<int>(iterators.begin(), iterators.begin() + liveRanges[temp].defDepth);
+}
+
+void InstructionGenerator::releaseTemp(int temp, const std::vector<int>& iterators) {
+    auto& instances = liveTemps[temp];
+    auto it = instances.find(tempPrefix(temp, iterators));
+    if (it != instances.end()) {
+        memoryMapper.releaseTemp(it->second);
+        instances.erase(it);
+    }
+}
+
+void InstructionGenerator::releaseDeadTemps(int index, const std::vector<int>& iterators) {
+    // Temporaries used by a nested loop stay live until its last iteration
+    // (see generatePoint); the others die at their last use
+    const auto& inst = nest.body[index];
+    for (const Operand* operand : {&inst.src1, &inst.src2}) {
+        if (operand->kind != Operand::Kind::TEMP || (operand == &inst.src2 && inst.src1.kind == Operand::Kind::TEMP &&
+                                                     inst.src1.id == inst.src2.id)) {
+            continue;
+        }
+        const auto& range = liveRanges[operand->id];
+        if (range.lastUse == index && !range.crossesLoop()) {
+            releaseTemp(operand->id, iterators);
+        }
+    }
+}
+
+std::tuple<int, int, int> InstructionGenerator::partialKey(const std::vector<int>& iterators, int chunk) const {
+    // A split and a fused reduction are the same one, so either access will do
+    const auto& access = nest.accesses[splitAccess >= 0 ? splitAccess : macAccess];
+    return std::make_tuple(chunk, access.row.evaluate(iterators), access.col.evaluate(iterators));
+}
+
+void InstructionGenerator::generateLoadInstructions(const MemoryLocation& destLocation, const MemoryLocation& srcLocation, int coreId) {
     // Generate LOAD instruction
     PimInstruction loadInst;
     loadInst.opcode = Opcode::LOAD;
     loadInst.core_id = coreId;
-    loadInst.row_addr = srcRow;
+    loadInst.row_addr = srcLocation.row;
+    loadInst.col_addr = srcLocation.col;
     loadInst.flags = Flags::READ;
-    instructions.push_back(loadInst);
+    sink->emit(loadInst);
     
     // Generate STORE instruction to save to destination
     PimInstruction storeInst;
     storeInst.opcode = Opcode::STORE;
     storeInst.core_id = coreId;
-    storeInst.row_addr = destRow;
+    storeInst.row_addr = destLocation.row;
+    storeInst.col_addr = destLocation.col;
     storeInst.flags = Flags::WRITE;
-    instructions.push_back(storeInst);
-    
-    return instructions;
+    sink->emit(storeInst);
 }
 
-std::vector<PimInstruction> InstructionGenerator::generateStoreInstructions(const std::string& dest, const std::string& src, int coreId) {
-    std::vector<PimInstruction> instructions;
-    
-    // Map source variable to DRAM row
-    uint16_t srcRow = memoryMapper.mapVariableToRow(src);
-    
-    // Map destination variable to DRAM row
-    uint16_t destRow = memoryMapper.mapVariableToRow(dest);
-    
+void InstructionGenerator::generateStoreInstructions(const MemoryLocation& destLocation, const MemoryLocation& srcLocation, int coreId) {
     // Generate LOAD instruction to get the source value
     PimInstruction loadInst;
     loadInst.opcode = Opcode::LOAD;
     loadInst.core_id = coreId;
-    loadInst.row_addr = srcRow;
+    loadInst.row_addr = srcLocation.row;
+    loadInst.col_addr = srcLocation.col;
     loadInst.flags = Flags::READ;
-    instructions.push_back(loadInst);
+    sink->emit(loadInst);
     
     // Generate STORE instruction
     PimInstruction storeInst;
     storeInst.opcode = Opcode::STORE;
     storeInst.core_id = coreId;
-    storeInst.row_addr = destRow;
+    storeInst.row_addr = destLocation.row;
+    storeInst.col_addr = destLocation.col;
     storeInst.flags = Flags::WRITE;
-    instructions.push_back(storeInst);
-    
-    return instructions;
+    sink->emit(storeInst);
 }
 
-std::vector<PimInstruction> InstructionGenerator::generateAddInstructions(const std::string& dest, const std::string& src1, const std::string& src2, int coreId) {
-    std::vector<PimInstruction> instructions;
-    
-    // Map source variables to DRAM rows
-    uint16_t src1Row = memoryMapper.mapVariableToRow(src1);
-    uint16_t src2Row = memoryMapper.mapVariableToRow(src2);
-    
-    // Map destination variable to DRAM row
-    uint16_t destRow = memoryMapper.mapVariableToRow(dest);
-    
+void InstructionGenerator::generateAddInstructions(const MemoryLocation& destLocation, const MemoryLocation& src1Location, const MemoryLocation& src2Location, int coreId) {
     // Program LUT for addition
-    PimInstruction programLutInst;
-    programLutInst.opcode = Opcode::PROGRAM_LUT;
-    programLutInst.core_id = coreId;
-    programLutInst.row_addr = 0;  // Special row for LUT programming
-    programLutInst.flags = 0;     // Addition operation
-    instructions.push_back(programLutInst);
+    programLut(LutFunction::ADD, coreId);
     
     // Load first operand
     PimInstruction load1Inst;
     load1Inst.opcode = Opcode::LOAD;
     load1Inst.core_id = coreId;
-    load1Inst.row_addr = src1Row;
+    load1Inst.row_addr = src1Location.row;
+    load1Inst.col_addr = src1Location.col;
     load1Inst.flags = Flags::READ;
-    instructions.push_back(load1Inst);
+    sink->emit(load1Inst);
     
     // Load second operand
     PimInstruction load2Inst;
     load2Inst.opcode = Opcode::LOAD;
     load2Inst.core_id = coreId;
-    load2Inst.row_addr = src2Row;
+    load2Inst.row_addr = src2Location.row;
+    load2Inst.col_addr = src2Location.col;
     load2Inst.flags = Flags::READ;
-    instructions.push_back(load2Inst);
+    sink->emit(load2Inst);
     
     // Compute addition
     PimInstruction computeInst;
@@ -209,52 +904,57 @@ std::vector<PimInstruction> InstructionGenerator::generateAddInstructions(const
     computeInst.core_id = coreId;
     computeInst.row_addr = 0;  // Result goes to a temporary register
     computeInst.flags = 0;
-    instructions.push_back(computeInst);
+    sink->emit(computeInst);
     
     // Store result
     PimInstruction storeInst;
     storeInst.opcode = Opcode::STORE;
     storeInst.core_id = coreId;
-    storeInst.row_addr = destRow;
+    storeInst.row_addr = destLocation.row;
+    storeInst.col_addr = destLocation.col;
     storeInst.flags = Flags::WRITE;
-    instructions.push_back(storeInst);
-    
-    return instructions;
+    sink->emit(storeInst);
 }
 
-std::vector<PimInstruction> InstructionGenerator::generateMultiplyInstructions(const std::string& dest, const std::string& src1, const std::string& src2, int coreId) {
-    std::vector<PimInstruction> instructions;
-    
-    // Map source variables to DRAM rows
-    uint16_t src1Row = memoryMapper.mapVariableToRow(src1);
-    uint16_t src2Row = memoryMapper.mapVariableToRow(src2);
-    
-    // Map destination variable to DRAM row
-    uint16_t destRow = memoryMapper.mapVariableToRow(dest);
-    
-    // Program LUT for multiplication
-    PimInstruction programLutInst;
-    programLutInst.opcode = Opcode::PROGRAM_LUT;
-    programLutInst.core_id = coreId;
-    programLutInst.row_addr = 0;  // Special row for LUT programming
-    programLutInst.flags = 1;     // Multiplication operation
-    instructions.push_back(programLutInst);
+void InstructionGenerator::generateMultiplyOperands(const MemoryLocation& src1Location, const MemoryLocation& src2Location, int coreId) {
+    // Program LUT for multiplication, by the constant if there is one
+    if (multiplyByConstant) {
+        programLut(LutFunction::MULTIPLY_BY_CONSTANT, coreId, multiplyConstant);
+    } else {
+        programLut(LutFunction::MULTIPLY, coreId);
+    }
     
     // Load first operand
     PimInstruction load1Inst;
     load1Inst.opcode = Opcode::LOAD;
     load1Inst.core_id = coreId;
-    load1Inst.row_addr = src1Row;
+    load1Inst.row_addr = src1Location.row;
+    load1Inst.col_addr = src1Location.col;
     load1Inst.flags = Flags::READ;
-    instructions.push_back(load1Inst);
+    sink->emit(load1Inst);
     
-    // Load second operand
+    // Load second operand, which the LUT holds for a multiply by a constant
+    if (multiplyByConstant) {
+        return;
+    }
     PimInstruction load2Inst;
     load2Inst.opcode = Opcode::LOAD;
     load2Inst.core_id = coreId;
-    load2Inst.row_addr = src2Row;
+    load2Inst.row_addr = src2Location.row;
+    load2Inst.col_addr = src2Location.col;
     load2Inst.flags = Flags::READ;
-    instructions.push_back(load2Inst);
+    sink->emit(load2Inst);
+}
+
+void InstructionGenerator::generateMultiplyInstructions(const MemoryLocation& destLocation, const MemoryLocation& src1Location, const MemoryLocation& src2Location, int coreId) {
+    // A product by zero is zero
+    if (multiplyByConstant && multiplyConstant == 0) {
+        zeroProductsSkipped++;
+        generateMoveInstructions(destLocation, destLocation, true, coreId);
+        return;
+    }
+    
+    generateMultiplyOperands(src1Location, src2Location, coreId);
     
     // Compute multiplication
     PimInstruction computeInst;
@@ -262,54 +962,46 @@ std::vector<PimInstruction> InstructionGenerator::generateMultiplyInstructions(c
     computeInst.core_id = coreId;
     computeInst.row_addr = 0;  // Result goes to a temporary register
     computeInst.flags = 0;
-    instructions.push_back(computeInst);
+    sink->emit(computeInst);
     
     // Store result
     PimInstruction storeInst;
     storeInst.opcode = Opcode::STORE;
     storeInst.core_id = coreId;
-    storeInst.row_addr = destRow;
+    storeInst.row_addr = destLocation.row;
+    storeInst.col_addr = destLocation.col;
     storeInst.flags = Flags::WRITE;
-    instructions.push_back(storeInst);
-    
-    return instructions;
+    sink->emit(storeInst);
 }
 
-std::vector<PimInstruction> InstructionGenerator::generateMoveInstructions(const std::string& dest, const std::string& src, int coreId) {
-    std::vector<PimInstruction> instructions;
-    
-    // Map destination variable to DRAM row
-    uint16_t destRow = memoryMapper.mapVariableToRow(dest);
-    
+void InstructionGenerator::generateMoveInstructions(const MemoryLocation& destLocation, const MemoryLocation& srcLocation, bool srcIsZero, int coreId) {
     // Check if source is a constant
-    if (src == "0") {
+    if (srcIsZero) {
         // Generate a MOVE instruction with constant 0
         PimInstruction moveInst;
         moveInst.opcode = Opcode::MOVE;
         moveInst.core_id = coreId;
-        moveInst.row_addr = destRow;
+        moveInst.row_addr = destLocation.row;
+        moveInst.col_addr = destLocation.col;
         moveInst.flags = Flags::WRITE | Flags::RESET;  // RESET flag indicates constant 0
-        instructions.push_back(moveInst);
+        sink->emit(moveInst);
     } else {
-        // Map source variable to DRAM row
-        uint16_t srcRow = memoryMapper.mapVariableToRow(src);
-        
         // Generate LOAD instruction
         PimInstruction loadInst;
         loadInst.opcode = Opcode::LOAD;
         loadInst.core_id = coreId;
-        loadInst.row_addr = srcRow;
+        loadInst.row_addr = srcLocation.row;
+        loadInst.col_addr = srcLocation.col;
         loadInst.flags = Flags::READ;
-        instructions.push_back(loadInst);
+        sink->emit(loadInst);
         
         // Generate STORE instruction
         PimInstruction storeInst;
         storeInst.opcode = Opcode::STORE;
         storeInst.core_id = coreId;
-        storeInst.row_addr = destRow;
+        storeInst.row_addr = destLocation.row;
+        storeInst.col_addr = destLocation.col;
         storeInst.flags = Flags::WRITE;
-        instructions.push_back(storeInst);
+        sink->emit(storeInst);
     }
-    
-    return instructions;
 }
\ No newline at end of file
@@ -1,47 +1,273 @@
 #ifndef INSTRUCTION_GENERATOR_H
 #define INSTRUCTION_GENERATOR_H
 
-#include "parser.h"
+#include "loop_nest.h"
 #include "loop_analyzer.h"
 #include "memory_mapper.h"
+#include "liveness_analyzer.h"
+#include "target_config.h"
+#include "work_distribution.h"
+#include "instruction_sink.h"
+#include "constant_matrix.h"
 #include "../include/pim_isa.h"
 #include <vector>
+#include <map>
+#include <tuple>
 
 class InstructionGenerator {
 public:
-    InstructionGenerator(const std::vector<ThreeAddressInst>& code,
+    InstructionGenerator(const LoopNest& nest,
                          const std::vector<Loop>& loops,
                          MemoryMapper& memoryMapper);
     
     // Generate PIM ISA instructions
     std::vector<PimInstruction> generateInstructions();
     
+    // Generate PIM ISA instructions into a sink, in program order, without
+    // holding on to them
+    void generateInstructions(InstructionSink& sink);
+    
+    // Run the loops in this order, outermost first, given as levels of the nest
+    void setLoopOrder(const std::vector<int>& order);
+    
+    // Split a reduction into chunks of its loop that run on different cores;
+    // the partial results are combined with a log-depth tree of MOVE +
+    // COMPUTE(ACCUMULATE). Fails unless the reduction is a sum over one loop.
+    bool splitReduction(const Reduction& reduction, int ways);
+    
+    // Lower a sum of products as COMPUTE(ACCUMULATE) into an accumulator slot
+    // that stays resident across the reduction loop; the accumulator element
+    // is read once before the loop and written once after it. Fails unless
+    // the value added is a product used nowhere else.
+    bool fuseMultiplyAccumulate(const Reduction& reduction);
+    
+    // Take the values of a matrix as known at compile time. A multiply by one
+    // of its elements programs the LUT to multiply by that value and loads
+    // only the other operand; the matrix itself is never loaded. Fails unless
+    // the matrix is only loaded to be multiplied by something else.
+    bool setConstantMatrix(int matrix, const ConstantMatrix& values);
+    
+    // Get the number of loads of the constant matrix left out, and of
+    // multiplies by zero dropped
+    long getConstantLoadsSkipped() const;
+    long getZeroProductsSkipped() const;
+    
+    // Lower the points of different cores on up to this many threads; the
+    // instructions come out in the same order as with one
+    void setJobs(int jobs);
+    
+    // Get the number of threads the last generation used
+    int getWorkerCount() const;
+    
+    // Spread the parallel iterations over the target's cores with its work
+    // distribution, estimating their cycles with its latencies
+    void setTarget(const TargetConfig& target);
+    
+    // Get the estimated cycles of every core under the work distribution
+    const std::vector<long>& getCoreLoads() const;
+    
+    // Get the loops whose iterations are spread over cores, as levels of the
+    // original nest; empty when the kernel runs on one core
+    std::vector<int> getDistributedLoops() const;
+    
+    // Lower the multiplies of a tile before its other instructions so each
+    // core's LUT is reprogrammed once per tile rather than once per point
+    void setGroupMultiplies(bool enable);
+    
+    // Get the number of PROGRAM_LUT instructions emitted, and the number left
+    // out because the core's LUT already held the function
+    long getLutPrograms() const;
+    long getLutProgramsSkipped() const;
+    
 private:
+    // Sink receiving the instructions being generated
+    InstructionSink* sink = nullptr;
+    
+    // Parallel generation: the threads allowed and used, the worker this copy
+    // of the generator is (-1 when lowering every point), the points visited
+    // so far in walk order, and the worker's instructions with the number of
+    // every point it lowered and where the point's instructions end
+    int jobs = 1;
+    int workerCount = 1;
+    int worker = -1;
+    long pointCount = 0;
+    std::vector<PimInstruction> workerInstructions;
+    std::vector<std::pair<long, size_t>> pointEnds;
+    
     // Input code and analysis
-    const std::vector<ThreeAddressInst>& code;
+    const LoopNest& nest;
     const std::vector<Loop>& loops;
     MemoryMapper& memoryMapper;
     
-    // Maximum number of cores available
-    const int maxCores = 8;
+    // Target whose cores run the code, and the core of every unit of the
+    // parallel iterations
+    TargetConfig target;
+    CoreAssignment coreAssignment;
+    
+    // Order the loops run in, outermost first
+    std::vector<int> loopOrder;
+    
+    // Levels of the (at most two) outermost parallel loops in the loop order,
+    // whose iterations are spread over cores
+    std::vector<int> distributedLoops;
+    
+    // Reduction split across cores: the accumulator's access function, the
+    // loop it runs over and the number of iterations per chunk
+    int splitAccess = -1;
+    int splitLevel = -1;
+    int splitWays = 1;
+    int splitChunkSize = 0;
+    int splitStore = -1;
+    
+    // Fused multiply-accumulate: the body indices of the multiply and of the
+    // load, add and store of the accumulator it replaces, and the loops the
+    // reduction runs over
+    int macMultiply = -1;
+    int macLoad = -1;
+    int macUpdate = -1;
+    int macStore = -1;
+    int macAccess = -1;
+    std::vector<int> macLoops;
+    
+    // Chunk of the split reduction being lowered; chunk 0 accumulates into the
+    // array element itself and the others into partial results
+    int activeChunk = 0;
+    
+    // Temporary slots holding partial results, by chunk and accumulator
+    // element; chunk 0 is the accumulator of a fused multiply-accumulate
+    std::map<std::tuple<int, int, int>, MemoryLocation> partials;
+    
+    // Live ranges of the body's temporaries, indexed by temporary number
+    std::vector<LiveRange> liveRanges;
+    
+    // Slots of the live instances of every temporary, by the values of the
+    // loops enclosing its definition
+    std::vector<std::map<std::vector<int>, MemoryLocation>> liveTemps;
+    
+    // Function each core's LUT holds (-1 if not programmed yet) with its
+    // constant, and the number of PROGRAM_LUT instructions emitted and left out
+    std::vector<std::pair<int, int>> coreLut;
+    long lutPrograms = 0;
+    long lutProgramsSkipped = 0;
+    
+    // Matrix whose values are known (-1 if none) and its values; the body
+    // loads of it, folded into the multiplies, and for every temporary the
+    // access it was loaded from if it holds a constant (-1 otherwise)
+    int constantMatrix = -1;
+    const ConstantMatrix* constantValues = nullptr;
+    std::vector<bool> constantLoad;
+    std::vector<int> constantTempAccess;
+    long constantLoadsSkipped = 0;
+    long zeroProductsSkipped = 0;
     
-    // Generate instructions for a single three-address instruction
-    std::vector<PimInstruction> generateForInstruction(const ThreeAddressInst& inst, int coreId);
+    // Whether the multiply being lowered is by a constant, and its value
+    bool multiplyByConstant = false;
+    int multiplyConstant = 0;
+    
+    // Whether a tile lowers all its multiplies before the rest of the body,
+    // the body instructions taking part in that first pass, and the pass
+    // being lowered (0 when the tile is not split into passes)
+    bool groupMultiplies = true;
+    std::vector<bool> multiplyGroup;
+    int groupPass = 0;
+    
+    // Generate the instructions of one tile loop (level < depth) or point loop
+    // (depth <= level < 2 * depth), recursing into the nested loop
+    void generateLevel(int level, std::vector<int>& tileStarts, std::vector<int>& iterators);
+    
+    // Generate the body instructions that run at one point of the iteration
+    // space, unless the point belongs to another worker
+    void generatePoint(const std::vector<int>& iterators);
+    
+    // Lower the body at one point on its core
+    void lowerPoint(const std::vector<int>& iterators, int coreId);
+    
+    // Walk the whole iteration space
+    void generateAll();
+    
+    // Whether the points of different cores can be lowered independently:
+    // no state of the generator is shared between cores
+    bool canLowerCoresApart() const;
+    
+    // Generate instructions for a single three-address instruction of the body
+    void generateForInstruction(int index, const std::vector<int>& iterators, int coreId);
+    
+    // Location of an operand read at one iteration
+    MemoryLocation operandLocation(const Operand& operand, const std::vector<int>& iterators);
+    
+    // Give a new instance of a temporary a slot of the core defining it
+    MemoryLocation defineTemp(const Operand& operand, const std::vector<int>& iterators, int coreId);
+    
+    // Values of the loops enclosing a temporary's definition at this iteration
+    std::vector<int> tempPrefix(int temp, const std::vector<int>& iterators) const;
+    
+    // Free the slot of the instance of a temporary visible at this iteration
+    void releaseTemp(int temp, const std::vector<int>& iterators);
+    
+    // Free the slots of the temporaries an instruction reads for the last time
+    void releaseDeadTemps(int index, const std::vector<int>& iterators);
+    
+    // Key of a chunk's partial result of the split reduction at one iteration
+    std::tuple<int, int, int> partialKey(const std::vector<int>& iterators, int chunk) const;
+    
+    // Generate the tree combining the partial results of the split reduction
+    void generateReductionTree(const std::vector<int>& iterators, int coreId);
+    
+    // Generate a multiply fused with the add of the reduction it feeds
+    void generateMultiplyAccumulate(const MemoryLocation& src1Location, const MemoryLocation& src2Location,
+                                    const std::vector<int>& iterators, int coreId);
+    
+    // Whether this iteration is the first (or last) the current chunk of the
+    // fused reduction runs for its accumulator element
+    bool isReductionBoundary(const std::vector<int>& iterators, bool last) const;
+    
+    // Find the instructions a tile can lower in a first pass of multiplies:
+    // the multiplies of the innermost loop and the loads feeding them, provided
+    // they read no array the body writes
+    void findMultiplyGroup();
+    
+    // Program a core's LUT with a function, and the constant it multiplies
+    // by, unless it already holds them
+    void programLut(int function, int coreId, int constant = 0);
+    
+    // Core running a chunk of the split reduction
+    int chunkCore(int coreId, int chunk) const;
     
     // Generate instructions for loading data
-    std::vector<PimInstruction> generateLoadInstructions(const std::string& dest, const std::string& src, int coreId);
+    void generateLoadInstructions(const MemoryLocation& destLocation, const MemoryLocation& srcLocation, int coreId);
     
     // Generate instructions for storing data
-    std::vector<PimInstruction> generateStoreInstructions(const std::string& dest, const std::string& src, int coreId);
+    void generateStoreInstructions(const MemoryLocation& destLocation, const MemoryLocation& srcLocation, int coreId);
     
     // Generate instructions for addition
-    std::vector<PimInstruction> generateAddInstructions(const std::string& dest, const std::string& src1, const std::string& src2, int coreId);
+    void generateAddInstructions(const MemoryLocation& destLocation, const MemoryLocation& src1Location, const MemoryLocation& src2Location, int coreId);
+    
+    // Program the LUT of a multiply and load its operands
+    void generateMultiplyOperands(const MemoryLocation& src1Location, const MemoryLocation& src2Location, int coreId);
     
     // Generate instructions for multiplication
-    std::vector<PimInstruction> generateMultiplyInstructions(const std::string& dest, const std::string& src1, const std::string& src2, int coreId);
+    void generateMultiplyInstructions(const MemoryLocation& destLocation, const MemoryLocation& src1Location, const MemoryLocation& src2Location, int coreId);
     
     // Generate instructions for moving data
-    std::vector<PimInstruction> generateMoveInstructions(const std::string& dest, const std::string& src, int coreId);
+    void generateMoveInstructions(const MemoryLocation& destLocation, const MemoryLocation& srcLocation, bool srcIsZero, int coreId);
+    
+    // Whether a loop is at its last iteration
+    bool isLastIteration(int level, const std::vector<int>& iterators) const;
+    
+    // Coordinate of a parallel iteration for core assignment: its tile index
+    // when the loop is tiled, otherwise its iteration number
+    int coreCoordinate(int level, int value) const;
+    
+    // Number of coordinates of a loop, and the iterations at one of them
+    int coordinateCount(int level) const;
+    int coordinateIterations(int level, int coordinate) const;
+    
+    // Estimated cycles of one execution of a body instruction
+    long estimateCycles(const ThreeAddressInst& inst) const;
+    
+    // Estimate the cycles of every unit of parallel iterations and assign the
+    // units to cores
+    void distributeWork();
     
     // Assign a core ID for a loop iteration
     int assignCoreId(int i, int j);
@@ -0,0 +1,52 @@
+#include "instruction_sink.h"
+#include <iomanip>
+
+BufferSink::BufferSink(std::vector<PimInstruction>& instructions)
+    : instructions(instructions) {
+}
+
+void BufferSink::emit(const PimInstruction& inst) {
+    instructions.push_back(inst);
+}
+
+StreamSink::StreamSink(std::ostream& out, size_t chunkSize)
+    : out(out), chunkSize(chunkSize > 0 ? chunkSize : 1) {
+    chunk.reserve(this->chunkSize);
+    printInstructionHeader(out);
+}
+
+void StreamSink::emit(const PimInstruction& inst) {
+    chunk.push_back(inst);
+    count++;
+    if (chunk.size() == chunkSize) {
+        flush();
+    }
+}
+
+bool StreamSink::finish() {
+    flush();
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+long StreamSink::getCount() const {
+    return count;
+}
+
+void StreamSink::flush() {
+    for (const auto& inst : chunk) {
+        printInstruction(inst, out);
+    }
+    chunk.clear();
+}
+
+void printInstructionHeader(std::ostream& out) {
+    out << "# PIM ISA Instructions for Matrix Multiplication" << std::endl;
+    out << "# Format: [Binary] [Opcode] core=[Core ID] row=[Row Address] flags=[Flags] col=[Column]" << std::endl;
+    out << std::endl;
+}
+
+void printInstruction(const PimInstruction& inst, std::ostream& out) {
+    out << std::setw(12) << std::setfill('0') << std::hex << inst.toBinary() << " ";
+    out << std::setw(0) << std::setfill(' ') << std::dec << inst.toString() << '\n';
+}
\ No newline at end of file
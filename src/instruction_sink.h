@@ -0,0 +1,59 @@
+#ifndef INSTRUCTION_SINK_H
+#define INSTRUCTION_SINK_H
+
+#include "../include/pim_isa.h"
+#include <ostream>
+#include <vector>
+
+// Receives instructions one at a time, in program order
+class InstructionSink {
+public:
+    virtual ~InstructionSink() = default;
+    
+    // Take the next instruction
+    virtual void emit(const PimInstruction& inst) = 0;
+    
+    // Pass on whatever is still buffered; returns whether that succeeded
+    virtual bool finish() { return true; }
+};
+
+// Appends the instructions to a vector
+class BufferSink : public InstructionSink {
+public:
+    BufferSink(std::vector<PimInstruction>& instructions);
+    
+    void emit(const PimInstruction& inst) override;
+    
+private:
+    std::vector<PimInstruction>& instructions;
+};
+
+// Writes the instructions as text to a stream, a fixed-size chunk at a time,
+// so memory use does not grow with the program
+class StreamSink : public InstructionSink {
+public:
+    StreamSink(std::ostream& out, size_t chunkSize = 4096);
+    
+    void emit(const PimInstruction& inst) override;
+    bool finish() override;
+    
+    // Get the number of instructions written so far
+    long getCount() const;
+    
+private:
+    std::ostream& out;
+    std::vector<PimInstruction> chunk;
+    size_t chunkSize;
+    long count = 0;
+    
+    // Write the buffered chunk
+    void flush();
+};
+
+// Write the header of an instruction listing
+void printInstructionHeader(std::ostream& out);
+
+// Write one instruction as a line of an instruction listing
+void printInstruction(const PimInstruction& inst, std::ostream& out);
+
+#endif // INSTRUCTION_SINK_H
\ No newline at end of file
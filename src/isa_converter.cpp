@@ -2,101 +2,10 @@
 #include <fstream>
 #include <string>
 #include <sstream>
-#include <map>
 #include <vector>
-#include <iomanip>
 #include <cstdint>  // Add this include for uint8_t, uint16_t, uint32_t
-
-// Structure to hold the paper's ISA format
-struct PaperISAInstruction {
-    uint8_t opType;     // 2 bits (00=NoOp, 01=PROG, 10=EXE, 11=END)
-    uint8_t pointer;    // 6 bits (core pointer or operation pointer)
-    bool readBit;       // 1 bit
-    bool writeBit;      // 1 bit
-    uint16_t rowAddr;   // 8 bits
-    
-    // Rest of the code remains unchanged
-    
-    // Convert to 24-bit binary representation (as a 32-bit int for convenience)
-    uint32_t toBinary() const {
-        uint32_t result = 0;
-        
-        // Upper 8 bits: 2-bit op type + 6-bit pointer
-        result |= (opType & 0x3) << 22;
-        result |= (pointer & 0x3F) << 16;
-        
-        // Next 10 bits: read bit + write bit + 8-bit row address
-        result |= (readBit ? 1 : 0) << 15;
-        result |= (writeBit ? 1 : 0) << 14;
-        result |= (rowAddr & 0xFF) << 6;
-        
-        // Lower 6 bits are reserved (set to 0)
-        
-        return result;
-    }
-    
-    // Convert to string representation
-    std::string toString() const {
-        std::stringstream ss;
-        
-        // Convert to binary and format as 6 hex digits
-        ss << std::hex << std::setw(6) << std::setfill('0') << toBinary();
-        
-        // Add operation type
-        ss << " ";
-        switch (opType) {
-            case 0: ss << "NoOp"; break;
-            case 1: ss << "PROG"; break;
-            case 2: ss << "EXE"; break;
-            case 3: ss << "END"; break;
-        }
-        
-        // Add pointer, read/write bits, and row address
-        ss << " ptr=0x" << std::hex << (int)pointer;
-        ss << " rd=" << (readBit ? "1" : "0");
-        ss << " wr=" << (writeBit ? "1" : "0");
-        ss << " row=0x" << std::hex << std::setw(2) << std::setfill('0') << rowAddr;
-        
-        return ss.str();
-    }
-};
-
-// Map existing opcodes to the paper's format
-PaperISAInstruction convertInstruction(const std::string& opcode, int coreId, int rowAddr, int flags) {
-    PaperISAInstruction result;
-    
-    // Default values
-    result.opType = 0;  // NoOp
-    result.pointer = coreId & 0x3F;  // Use core ID as pointer (limited to 6 bits)
-    result.readBit = false;
-    result.writeBit = false;
-    result.rowAddr = rowAddr & 0xFF;  // Limit to 8 bits
-    
-    // Map opcodes to paper's format
-    if (opcode == "PROGRAM_LUT") {
-        result.opType = 1;  // PROG
-        result.pointer = coreId & 0x3F;
-    }
-    else if (opcode == "COMPUTE") {
-        result.opType = 2;  // EXE
-        result.pointer = flags & 0x3F;  // Use flags as operation pointer
-    }
-    else if (opcode == "SYNC") {
-        result.opType = 3;  // END
-    }
-    else if (opcode == "LOAD") {
-        result.readBit = true;
-    }
-    else if (opcode == "STORE") {
-        result.writeBit = true;
-    }
-    else if (opcode == "MOVE") {
-        result.readBit = true;
-        result.writeBit = true;
-    }
-    
-    return result;
-}
+#include "binary_program.h"
+#include "paper_encoder.h"
 
 int main(int argc, char* argv[]) {
     if (argc != 3) {
@@ -107,67 +16,72 @@ int main(int argc, char* argv[]) {
     std::string inputFile = argv[1];
     std::string outputFile = argv[2];
     
-    std::ifstream inFile(inputFile);
-    if (!inFile) {
-        std::cerr << "Error: Could not open input file " << inputFile << std::endl;
-        return 1;
-    }
-    
-    std::ofstream outFile(outputFile);
-    if (!outFile) {
-        std::cerr << "Error: Could not open output file " << outputFile << std::endl;
-        return 1;
-    }
-    
-    // Write header
-    outFile << "# PIM ISA Instructions in Paper Format (24-bit)" << std::endl;
-    outFile << "# Format: [Hex] [OpType] ptr=[Pointer] rd=[ReadBit] wr=[WriteBit] row=[RowAddress]" << std::endl;
-    outFile << std::endl;
-    
-    std::string line;
-    while (std::getline(inFile, line)) {
-        // Skip comments and empty lines
-        if (line.empty() || line[0] == '#') {
-            continue;
+    // Read the instructions: a binary program in place from its mapping, a
+    // listing from the binary word that starts every line
+    std::vector<PimInstruction> instructions;
+    std::vector<PaperISAInstruction> paperInstructions;
+    bool encoded = false;
+    if (MappedProgram::isBinaryProgram(inputFile)) {
+        MappedProgram program;
+        if (!program.open(inputFile)) {
+            return 1;
         }
-        
-        // Parse the existing ISA format
-        std::istringstream iss(line);
-        std::string binary, opcode, coreStr, rowStr, flagsStr;
-        
-        iss >> binary >> opcode;
-        
-        // Extract core ID, row address, and flags
-        int coreId = 0, rowAddr = 0, flags = 0;
-        
-        if (iss >> coreStr >> rowStr >> flagsStr) {
-            // Extract core ID
-            size_t pos = coreStr.find("=");
-            if (pos != std::string::npos) {
-                coreId = std::stoi(coreStr.substr(pos + 1));
+        encoded = program.getHeader().encoding == BinaryProgramHeader::Encoding::PAPER;
+        for (size_t i = 0; i < program.size(); i++) {
+            if (encoded) {
+                paperInstructions.push_back(PaperISAInstruction::fromBinary(program.word(i)));
+            } else {
+                instructions.push_back(program[i]);
             }
+        }
+    } else {
+        std::ifstream inFile(inputFile);
+        if (!inFile) {
+            std::cerr << "Error: Could not open input file " << inputFile << std::endl;
+            return 1;
+        }
+        
+        std::string line;
+        long lineNumber = 0;
+        while (std::getline(inFile, line)) {
+            lineNumber++;
             
-            // Extract row address
-            pos = rowStr.find("=");
-            if (pos != std::string::npos) {
-                rowAddr = std::stoi(rowStr.substr(pos + 1), nullptr, 16);
+            // Skip comments and empty lines
+            if (line.empty() || line[0] == '#') {
+                continue;
             }
             
-            // Extract flags
-            pos = flagsStr.find("=");
-            if (pos != std::string::npos) {
-                flags = std::stoi(flagsStr.substr(pos + 1), nullptr, 16);
+            std::istringstream iss(line);
+            std::string binary;
+            iss >> binary;
+            size_t parsed = 0;
+            uint64_t word = 0;
+            try {
+                word = std::stoull(binary, &parsed, 16);
+            } catch (const std::exception&) {
+                parsed = 0;
             }
+            if (parsed == 0 || parsed != binary.size()) {
+                std::cerr << "Error: line " << lineNumber << " does not start with an instruction word: " << line
+                          << std::endl;
+                return 1;
+            }
+            instructions.push_back(PimInstruction::fromBinary(word));
         }
-        
-        // Convert to paper's format
-        PaperISAInstruction paperInst = convertInstruction(opcode, coreId, rowAddr, flags);
-        
-        // Write to output file
-        outFile << paperInst.toString() << std::endl;
     }
     
-    inFile.close();
+    // Convert to paper's format
+    PaperEncoder paperEncoder;
+    if (!encoded && !paperEncoder.encode(instructions, paperInstructions)) {
+        return 1;
+    }
+    
+    std::ofstream outFile(outputFile);
+    if (!outFile) {
+        std::cerr << "Error: Could not open output file " << outputFile << std::endl;
+        return 1;
+    }
+    PaperEncoder::print(paperInstructions, outFile);
     outFile.close();
     
     std::cout << "Conversion complete. Output written to " << outputFile << std::endl;
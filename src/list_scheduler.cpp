@@ -0,0 +1,291 @@
+#include "list_scheduler.h"
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+
+namespace {
+
+// Number of cores the instructions name
+int countCores(const std::vector<PimInstruction>& instructions) {
+    int cores = 1;
+    for (const auto& inst : instructions) {
+        cores = std::max(cores, inst.core_id + 1);
+    }
+    return cores;
+}
+
+// Key of a row and column
+uint32_t locationKey(const PimInstruction& inst) {
+    return (static_cast<uint32_t>(inst.row_addr) << 16) | inst.col_addr;
+}
+
+// Whether an instruction is a MOVE taking a broadcast value
+bool isForwarded(const PimInstruction& inst) {
+    return inst.opcode == Opcode::MOVE && (inst.flags & Flags::READ) && (inst.flags & Flags::PARALLEL);
+}
+
+// Whether an instruction needs the shared bus; forwarded values come over
+// the links between the cores
+bool usesBus(const PimInstruction& inst) {
+    return (inst.opcode == Opcode::LOAD || inst.opcode == Opcode::STORE || inst.opcode == Opcode::MOVE) &&
+           !isForwarded(inst);
+}
+
+} // namespace
+
+ListScheduler::ListScheduler(const TargetConfig& target)
+    : target(target) {
+}
+
+int ListScheduler::latency(const PimInstruction& inst) const {
+    switch (inst.opcode) {
+        case Opcode::LOAD:
+            return target.loadLatency;
+        case Opcode::STORE:
+            return target.storeLatency;
+        case Opcode::PROGRAM_LUT:
+            return target.lutLatency;
+        case Opcode::COMPUTE:
+            return target.computeLatency;
+        case Opcode::MOVE:
+            return target.moveLatency;
+        case Opcode::SYNC:
+            return target.syncLatency;
+        default:
+            return 1;
+    }
+}
+
+void ListScheduler::buildDependences(const std::vector<PimInstruction>& instructions) {
+    offsets.assign(1, 0);
+    predecessors.clear();
+    delays.clear();
+    int coreCount = countCores(instructions);
+    
+    // Last writer of every location and the readers since
+    struct LocationState {
+        long lastWriter = -1;
+        std::vector<long> readers;
+    };
+    std::unordered_map<uint32_t, LocationState> locations;
+    
+    // Per core: the last instruction, the instructions filling the operand
+    // buffer, and the last to set the output register, program the LUT and
+    // compute with it
+    std::vector<long> lastOnCore(coreCount, -1);
+    std::vector<std::vector<long>> operands(coreCount);
+    std::vector<long> lastOutput(coreCount, -1);
+    std::vector<long> lastLut(coreCount, -1);
+    std::vector<long> lastCompute(coreCount, -1);
+    
+    // Last broadcast of every location
+    std::unordered_map<uint32_t, long> broadcasts;
+    
+    // Signals sent from core p to core c, and how many of them were waited for
+    std::vector<std::vector<long>> signals(static_cast<size_t>(coreCount) * coreCount);
+    std::vector<size_t> signalsWaited(signals.size(), 0);
+    
+    auto waitFor = [&](long predecessor, int delay) {
+        if (predecessor >= 0) {
+            predecessors.push_back(predecessor);
+            delays.push_back(delay);
+        }
+    };
+    
+    for (long i = 0; i < static_cast<long>(instructions.size()); i++) {
+        const auto& inst = instructions[i];
+        int core = inst.core_id;
+        auto& location = locations[locationKey(inst)];
+        auto read = [&]() {
+            if (location.lastWriter >= 0) {
+                waitFor(location.lastWriter, latency(instructions[location.lastWriter]));
+            }
+            location.readers.push_back(i);
+        };
+        auto write = [&]() {
+            for (long reader : location.readers) {
+                if (reader != i) {
+                    waitFor(reader, 1);
+                }
+            }
+            waitFor(location.lastWriter, 1);
+            location.readers.clear();
+            location.lastWriter = i;
+        };
+        
+        // A core issues in order
+        waitFor(lastOnCore[core], 1);
+        lastOnCore[core] = i;
+        
+        switch (inst.opcode) {
+            case Opcode::LOAD:
+                read();
+                operands[core].push_back(i);
+                lastOutput[core] = i;
+                if (inst.flags & Flags::PARALLEL) {
+                    broadcasts[locationKey(inst)] = i;
+                }
+                break;
+            case Opcode::STORE:
+                waitFor(lastOutput[core], lastOutput[core] >= 0 ? latency(instructions[lastOutput[core]]) : 0);
+                write();
+                operands[core].clear();
+                break;
+            case Opcode::COMPUTE:
+                for (long operand : operands[core]) {
+                    waitFor(operand, latency(instructions[operand]));
+                }
+                waitFor(lastLut[core], target.lutLatency);
+                if (inst.flags & Flags::ACCUMULATE) {
+                    read();
+                    write();
+                }
+                operands[core].clear();
+                lastOutput[core] = i;
+                lastCompute[core] = i;
+                break;
+            case Opcode::PROGRAM_LUT:
+                // The LUT changes once the computations using it are done
+                waitFor(lastCompute[core], target.computeLatency);
+                lastLut[core] = i;
+                break;
+            case Opcode::MOVE:
+                if (isForwarded(inst)) {
+                    // A forwarded value is taken like a load once it is
+                    // broadcast
+                    auto broadcast = broadcasts.find(locationKey(inst));
+                    if (broadcast != broadcasts.end()) {
+                        waitFor(broadcast->second, target.loadLatency);
+                    }
+                    read();
+                    operands[core].push_back(i);
+                    lastOutput[core] = i;
+                } else if (inst.flags & Flags::READ) {
+                    read();
+                    operands[core].push_back(i);
+                } else if (inst.flags & (Flags::WRITE | Flags::RESET)) {
+                    write();
+                }
+                break;
+            case Opcode::SYNC:
+                // A wait follows the matching signal of the other core
+                if (inst.flags & Flags::WRITE) {
+                    signals[static_cast<size_t>(core) * coreCount + inst.row_addr % coreCount].push_back(i);
+                } else if (inst.flags & Flags::READ) {
+                    size_t pair = static_cast<size_t>(inst.row_addr % coreCount) * coreCount + core;
+                    if (signalsWaited[pair] < signals[pair].size()) {
+                        waitFor(signals[pair][signalsWaited[pair]++], target.syncLatency);
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        offsets.push_back(predecessors.size());
+    }
+}
+
+std::vector<PimInstruction> ListScheduler::schedule(const std::vector<PimInstruction>& instructions) {
+    long count = instructions.size();
+    buildDependences(instructions);
+    
+    // Priority: the longest latency path from an instruction to the end
+    std::vector<long> height(count, 0);
+    serialCycles = 0;
+    for (long i = count - 1; i >= 0; i--) {
+        int own = latency(instructions[i]);
+        serialCycles += own;
+        height[i] = std::max(height[i], static_cast<long>(own));
+        for (long e = offsets[i]; e < offsets[i + 1]; e++) {
+            height[predecessors[e]] = std::max(height[predecessors[e]], height[i] + delays[e]);
+        }
+    }
+    
+    int coreCount = countCores(instructions);
+    std::vector<std::vector<long>> streams(coreCount);
+    for (long i = 0; i < count; i++) {
+        streams[instructions[i].core_id].push_back(i);
+    }
+    
+    // Issue cycle by cycle. An instruction at the head of its core's stream
+    // is ready once all it waits for has issued and the delays have passed;
+    // the predecessors already seen to have issued are not checked again.
+    std::vector<long> issued(count, -1);
+    std::vector<long> readyAt(count, 0);
+    std::vector<long> checked(offsets.begin(), offsets.end() - 1);
+    std::vector<size_t> head(coreCount, 0);
+    std::vector<long> ready;
+    std::vector<PimInstruction> scheduled;
+    scheduled.reserve(count);
+    cycles = 0;
+    busSlotsUsed = 0;
+    long cycle = 0;
+    while (static_cast<long>(scheduled.size()) < count) {
+        ready.clear();
+        long nextReady = LONG_MAX;
+        for (int core = 0; core < coreCount; core++) {
+            if (head[core] == streams[core].size()) {
+                continue;
+            }
+            long i = streams[core][head[core]];
+            for (; checked[i] < offsets[i + 1] && issued[predecessors[checked[i]]] >= 0; checked[i]++) {
+                readyAt[i] = std::max(readyAt[i], issued[predecessors[checked[i]]] + delays[checked[i]]);
+            }
+            if (checked[i] < offsets[i + 1]) {
+                continue;
+            }
+            if (readyAt[i] <= cycle) {
+                ready.push_back(i);
+            } else {
+                nextReady = std::min(nextReady, readyAt[i]);
+            }
+        }
+        std::sort(ready.begin(), ready.end(), [&](long a, long b) {
+            return height[a] != height[b] ? height[a] > height[b] : a < b;
+        });
+        
+        int busUsed = 0;
+        for (long i : ready) {
+            const auto& inst = instructions[i];
+            if (usesBus(inst)) {
+                if (busUsed == target.busWidth) {
+                    continue;
+                }
+                busUsed++;
+            }
+            issued[i] = cycle;
+            head[inst.core_id]++;
+            scheduled.push_back(inst);
+            cycles = std::max(cycles, cycle + latency(inst));
+        }
+        busSlotsUsed += busUsed;
+        
+        // Skip the cycles in which nothing can issue
+        cycle = ready.empty() && nextReady != LONG_MAX ? nextReady : cycle + 1;
+    }
+    
+    return scheduled;
+}
+
+std::vector<std::vector<PimInstruction>> ListScheduler::splitByCore(const std::vector<PimInstruction>& instructions) {
+    std::vector<std::vector<PimInstruction>> streams;
+    for (const auto& inst : instructions) {
+        if (inst.core_id >= streams.size()) {
+            streams.resize(inst.core_id + 1);
+        }
+        streams[inst.core_id].push_back(inst);
+    }
+    return streams;
+}
+
+long ListScheduler::getCycles() const {
+    return cycles;
+}
+
+long ListScheduler::getSerialCycles() const {
+    return serialCycles;
+}
+
+double ListScheduler::getBusUtilization() const {
+    return cycles > 0 ? static_cast<double>(busSlotsUsed) / (static_cast<double>(cycles) * target.busWidth) : 0.0;
+}
\ No newline at end of file
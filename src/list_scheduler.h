@@ -0,0 +1,58 @@
+#ifndef LIST_SCHEDULER_H
+#define LIST_SCHEDULER_H
+
+#include "target_config.h"
+#include "../include/pim_isa.h"
+#include <vector>
+
+// Interleaves the instructions of the cores. Every core issues its own
+// instructions in program order, one per cycle; an instruction waits until
+// the values it reads are ready, and LOAD, STORE and MOVE (except a MOVE
+// taking a broadcast value) also wait for a slot on the shared bus. Among the instructions ready in a cycle, the ones
+// with the longest latency path to the end of the program go first.
+class ListScheduler {
+public:
+    ListScheduler(const TargetConfig& target);
+    
+    // Schedule the instructions and return them in issue order
+    std::vector<PimInstruction> schedule(const std::vector<PimInstruction>& instructions);
+    
+    // Split instructions into one stream per core, keeping their order
+    static std::vector<std::vector<PimInstruction>> splitByCore(const std::vector<PimInstruction>& instructions);
+    
+    // Get the number of cycles until the last instruction completes
+    long getCycles() const;
+    
+    // Get the number of cycles the same instructions take issued one by one,
+    // each waiting for the previous one to complete
+    long getSerialCycles() const;
+    
+    // Get the fraction of bus slots in use over the schedule
+    double getBusUtilization() const;
+    
+private:
+    const TargetConfig& target;
+    
+    long cycles = 0;
+    long serialCycles = 0;
+    long busSlotsUsed = 0;
+    
+    // Dependences in compressed sparse row form, as in the loop analyzer: the
+    // instructions instruction i waits for are predecessors[offsets[i] ..
+    // offsets[i + 1]), each with the cycles it has to wait after their issue
+    std::vector<long> offsets;
+    std::vector<long> predecessors;
+    std::vector<int> delays;
+    
+    // Latency of an instruction
+    int latency(const PimInstruction& inst) const;
+    
+    // Find what every instruction waits for: the instructions of its core
+    // that fill the operand buffer, output register or LUT it uses, the
+    // instructions of any core that last wrote or read the location it
+    // accesses, for a SYNC waiting on another core, that core's signal, and
+    // for a forwarded MOVE, the broadcast it takes
+    void buildDependences(const std::vector<PimInstruction>& instructions);
+};
+
+#endif // LIST_SCHEDULER_H
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "liveness_analyzer.h"
+#include <cassert>
+
+LivenessAnalyzer::LivenessAnalyzer(const LoopNest& nest)
+    : nest(nest) {
+}
+
+void LivenessAnalyzer::analyze() {
+    liveRanges.assign(nest.tempCount, LiveRange());
+    
+    // The parser puts the body in program order, so one pass finds each
+    // temporary's definition and the last instruction reading it
+    assert(nest.isInProgramOrder());
+    for (int i = 0; i < nest.body.size(); i++) {
+        const auto& inst = nest.body[i];
+        for (const Operand* operand : {&inst.src1, &inst.src2}) {
+            if (operand->kind == Operand::Kind::TEMP) {
+                liveRanges[operand->id].lastUse = i;
+                liveRanges[operand->id].useDepth = inst.depth;
+            }
+        }
+        if (inst.dest.kind == Operand::Kind::TEMP) {
+            auto& range = liveRanges[inst.dest.id];
+            range.def = i;
+            range.defDepth = inst.depth;
+            if (range.lastUse < i) {
+                range.lastUse = i;
+                range.useDepth = inst.depth;
+            }
+        }
+    }
+}
+
+const std::vector<LiveRange>& LivenessAnalyzer::getLiveRanges() const {
+    return liveRanges;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef LIVENESS_ANALYZER_H
+#define LIVENESS_ANALYZER_H
+
+#include "loop_nest.h"
+#include <vector>
+
+// Live range of a temporary of the loop body. A temporary gets a new
+// instance every time its definition runs; the instance lives until the
+// last use that can read it.
+struct LiveRange {
+    int def = -1;        // Body index of the defining instruction
+    int lastUse = -1;    // Body index of the last use, or def if it is never used
+    int defDepth = 0;    // Number of loops enclosing the definition
+    int useDepth = 0;    // Number of loops enclosing the last use
+    
+    // Used by a loop nested inside the definition's: the instance lives until
+    // that loop's last iteration
+    bool crossesLoop() const { return useDepth > defDepth; }
+    
+    // Used after the loop enclosing the definition: only the instance of the
+    // last iteration is read, so earlier ones die when redefined
+    bool escapesLoop() const { return useDepth < defDepth; }
+};
+
+class LivenessAnalyzer {
+public:
+    LivenessAnalyzer(const LoopNest& nest);
+    
+    // Compute the live range of every temporary
+    void analyze();
+    
+    // Get the live ranges, indexed by temporary number
+    const std::vector<LiveRange>& getLiveRanges() const;
+    
+private:
+    const LoopNest& nest;
+    std::vector<LiveRange> liveRanges;
+};
+
+#endif // LIVENESS_ANALYZER_H
\ No newline at end of file
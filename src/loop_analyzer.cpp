@@ -2,108 +2,435 @@
 #include <iostream>
 #include <set>
 #include <algorithm>
+#include <numeric>
+#include <functional>
+#include <cassert>
 
-LoopAnalyzer::LoopAnalyzer(const std::vector<ThreeAddressInst>& code)
-    : code(code) {
+namespace {
+
+// Subscript of an access in normalized iteration space: every loop runs
+// t = 0 .. tripCount - 1 and the subscript is constant + sum(coeffs[d] * t[d])
+struct NormalizedSubscript {
+    std::vector<long> coeffs;
+    long constant;
+};
+
+NormalizedSubscript normalize(const AffineIndex& index, int depth, const std::vector<LoopBounds>& loops) {
+    NormalizedSubscript result;
+    result.coeffs.assign(depth, 0);
+    result.constant = index.constant;
+    for (int d = 0; d < depth && d < static_cast<int>(index.coeffs.size()); d++) {
+        result.coeffs[d] = static_cast<long>(index.coeffs[d]) * loops[d].step;
+        result.constant += static_cast<long>(index.coeffs[d]) * loops[d].lowerBound;
+    }
+    return result;
+}
+
+// Range of a*t - b*u over t, u in [0, n-1] for one direction; a linear
+// function reaches its extremes at the corners of the constrained region
+bool termRange(long a, long b, int n, uint8_t direction, long& lo, long& hi) {
+    std::vector<std::pair<long, long>> corners;
+    switch (direction) {
+        case Direction::EQ: corners = {{0, 0}, {n - 1, n - 1}}; break;
+        case Direction::LT:
+            if (n < 2) return false;
+            corners = {{0, 1}, {0, n - 1}, {n - 2, n - 1}};
+            break;
+        case Direction::GT:
+            if (n < 2) return false;
+            corners = {{1, 0}, {n - 1, 0}, {n - 1, n - 2}};
+            break;
+        default: corners = {{0, 0}, {0, n - 1}, {n - 1, 0}, {n - 1, n - 1}}; break;
+    }
+    lo = hi = a * corners[0].first - b * corners[0].second;
+    for (const auto& corner : corners) {
+        long value = a * corner.first - b * corner.second;
+        lo = std::min(lo, value);
+        hi = std::max(hi, value);
+    }
+    return true;
+}
+
+// GCD and Banerjee test of first(t) == second(u) for one subscript under a
+// direction vector over the common loops
+bool subscriptMayAlias(const NormalizedSubscript& first, const NormalizedSubscript& second,
+                       const std::vector<uint8_t>& directions, const std::vector<LoopBounds>& loops) {
+    long rhs = second.constant - first.constant;
+    long lo = 0, hi = 0, divisor = 0;
+    
+    for (size_t d = 0; d < std::max(first.coeffs.size(), second.coeffs.size()); d++) {
+        long a = d < first.coeffs.size() ? first.coeffs[d] : 0;
+        long b = d < second.coeffs.size() ? second.coeffs[d] : 0;
+        int n = loops[d].tripCount;
+        long termLo, termHi;
+        
+        if (d < directions.size()) {
+            if (!termRange(a, b, n, directions[d], termLo, termHi)) {
+                return false;
+            }
+            divisor = directions[d] == Direction::EQ ? std::gcd(divisor, a - b)
+                                                     : std::gcd(std::gcd(divisor, a), b);
+        } else {
+            // Loops enclosing only one of the accesses range freely
+            termRange(d < first.coeffs.size() ? a : 0, d < second.coeffs.size() ? b : 0,
+                      n, Direction::ALL, termLo, termHi);
+            divisor = std::gcd(std::gcd(divisor, a), b);
+        }
+        lo += termLo;
+        hi += termHi;
+    }
+    
+    if (divisor == 0 ? rhs != 0 : rhs % divisor != 0) {
+        return false;
+    }
+    return lo <= rhs && rhs <= hi;
+}
+
+} // namespace
+
+std::string Dependence::directionString() const {
+    std::string result = "(";
+    for (size_t d = 0; d < directions.size(); d++) {
+        if (d > 0) result += ", ";
+        switch (directions[d]) {
+            case Direction::LT: result += "<"; break;
+            case Direction::EQ: result += "="; break;
+            case Direction::GT: result += ">"; break;
+            case Direction::LT | Direction::EQ: result += "<="; break;
+            case Direction::GT | Direction::EQ: result += ">="; break;
+            case Direction::LT | Direction::GT: result += "!="; break;
+            default: result += "*"; break;
+        }
+    }
+    return result + ")";
+}
+
+std::string Dependence::distanceString() const {
+    std::string result = "(";
+    for (size_t d = 0; d < distances.size(); d++) {
+        if (d > 0) result += ", ";
+        result += distances[d] == UNKNOWN_DISTANCE ? "*" : std::to_string(distances[d]);
+    }
+    return result + ")";
+}
+
+LoopAnalyzer::LoopAnalyzer(const LoopNest& nest)
+    : nest(nest) {
 }
 
 void LoopAnalyzer::analyze() {
     buildDependencyGraph();
     identifyLoops();
+    findReductions();
+    analyzeDependences();
     analyzeParallelizability();
 }
 
 void LoopAnalyzer::buildDependencyGraph() {
-    dependencyGraph.clear();
+    dependencyOffsets.clear();
+    dependencyEdges.clear();
+    dependencyOffsets.reserve(nest.body.size() + 1);
+    dependencyEdges.reserve(2 * nest.body.size());
     
-    // Track variable definitions and uses
-    std::map<std::string, int> lastDef;
+    // Last instruction defining each symbol, indexed by interned ID
+    std::vector<int> lastDef(nest.symbols.size(), -1);
     
-    for (int i = 0; i < code.size(); i++) {
-        const auto& inst = code[i];
-        std::vector<int> dependencies;
+    // One linear pass: the edges of instruction i are appended right after those of i - 1
+    dependencyOffsets.push_back(0);
+    for (int i = 0; i < nest.body.size(); i++) {
+        const auto& inst = nest.body[i];
         
         // Check for dependencies on source operands
-        if (!inst.src1.empty() && lastDef.find(inst.src1) != lastDef.end()) {
-            dependencies.push_back(lastDef[inst.src1]);
+        int dep1 = inst.src1.symbol >= 0 ? lastDef[inst.src1.symbol] : -1;
+        int dep2 = inst.src2.symbol >= 0 ? lastDef[inst.src2.symbol] : -1;
+        if (dep1 >= 0) {
+            dependencyEdges.push_back(dep1);
         }
-        
-        if (!inst.src2.empty() && lastDef.find(inst.src2) != lastDef.end()) {
-            dependencies.push_back(lastDef[inst.src2]);
+        if (dep2 >= 0 && dep2 != dep1) {
+            dependencyEdges.push_back(dep2);
         }
+        dependencyOffsets.push_back(dependencyEdges.size());
         
         // Record this instruction as defining its destination
-        if (!inst.dest.empty()) {
-            lastDef[inst.dest] = i;
+        if (inst.dest.symbol >= 0) {
+            lastDef[inst.dest.symbol] = i;
         }
-        
-        dependencyGraph[i] = dependencies;
     }
 }
 
 void LoopAnalyzer::identifyLoops() {
     loops.clear();
     
-    // In a real implementation, this would analyze the control flow graph
-    // For this example, we'll use a simplified approach based on the
-    // three-address code structure we generated in the parser
+    // The parser recovered the nest from the kernel's LoopInfo; a loop spans
+    // the body instructions nested deeper than its own level
+    for (const auto& bounds : nest.loops) {
+        Loop loop;
+        loop.startIdx = -1;
+        loop.endIdx = -1;
+        for (int i = 0; i < nest.body.size(); i++) {
+            if (nest.body[i].depth > bounds.depth) {
+                if (loop.startIdx < 0) {
+                    loop.startIdx = i;
+                }
+                loop.endIdx = i;
+            }
+        }
+        loop.nestLevel = bounds.depth;
+        loop.inductionVar = bounds.inductionVar;
+        loop.lowerBound = bounds.lowerBound;
+        loop.upperBound = bounds.upperBound;
+        loop.step = bounds.step;
+        loop.isParallelizable = true;
+        loop.isReduction = false;
+        loop.tileSize = bounds.tripCount;
+        loops.push_back(loop);
+    }
+}
+
+void LoopAnalyzer::findReductions() {
+    reductions.clear();
     
-    // Identify the matrix multiplication loops
-    // We know there are 3 nested loops for i, j, k
+    // Body index of the instruction defining each temporary
+    std::vector<int> definition(nest.symbols.size(), -1);
+    for (int i = 0; i < nest.body.size(); i++) {
+        if (nest.body[i].dest.kind == Operand::Kind::TEMP) {
+            definition[nest.body[i].dest.symbol] = i;
+        }
+    }
     
-    Loop iLoop;
-    iLoop.startIdx = 0;
-    iLoop.endIdx = code.size() - 1;
-    iLoop.nestLevel = 0;
-    iLoop.inductionVar = "i";
-    iLoop.lowerBound = 0;
-    iLoop.upperBound = 2;  // 3x3 matrix example
-    iLoop.step = 1;
-    iLoop.isParallelizable = true;  // Outer loop can be parallelized
+    for (int store = 0; store < nest.body.size(); store++) {
+        const auto& storeInst = nest.body[store];
+        if (storeInst.op != ThreeAddressInst::OpType::STORE || storeInst.src1.kind != Operand::Kind::TEMP) {
+            continue;
+        }
+        
+        // The stored value must be acc op value, with acc loaded from the same element
+        int update = definition[storeInst.src1.symbol];
+        if (update < 0 || (nest.body[update].op != ThreeAddressInst::OpType::ADD &&
+                           nest.body[update].op != ThreeAddressInst::OpType::MULTIPLY)) {
+            continue;
+        }
+        const auto& updateInst = nest.body[update];
+        int load = -1;
+        for (const Operand* operand : {&updateInst.src1, &updateInst.src2}) {
+            int def = operand->kind == Operand::Kind::TEMP ? definition[operand->symbol] : -1;
+            if (def >= 0 && nest.body[def].op == ThreeAddressInst::OpType::LOAD &&
+                nest.body[def].src1.id == storeInst.dest.id && nest.body[def].depth == storeInst.depth) {
+                load = def;
+            }
+        }
+        if (load < 0 || (updateInst.src1.kind == Operand::Kind::TEMP && updateInst.src2.kind == Operand::Kind::TEMP &&
+                         updateInst.src1.symbol == updateInst.src2.symbol)) {
+            continue;
+        }
+        
+        // No other access to the accumulator's array may share its loops
+        const ArrayAccess& access = nest.accesses[storeInst.dest.id];
+        bool exclusive = true;
+        for (int i = 0; i < nest.body.size(); i++) {
+            const auto& inst = nest.body[i];
+            if (i == load || i == store || inst.depth < storeInst.depth) {
+                continue;
+            }
+            for (const Operand* operand : {&inst.dest, &inst.src1, &inst.src2}) {
+                if (operand->kind == Operand::Kind::ARRAY && nest.accesses[operand->id].array == access.array) {
+                    exclusive = false;
+                }
+            }
+        }
+        if (!exclusive) {
+            continue;
+        }
+        
+        // It runs over the enclosing loops the accumulator's subscripts do not use
+        Reduction reduction;
+        reduction.load = load;
+        reduction.update = update;
+        reduction.store = store;
+        reduction.access = storeInst.dest.id;
+        reduction.op = updateInst.op;
+        for (int d = 0; d < storeInst.depth; d++) {
+            if (access.row.coeffs[d] == 0 && access.col.coeffs[d] == 0) {
+                reduction.loops.push_back(d);
+            }
+        }
+        if (!reduction.loops.empty()) {
+            reductions.push_back(reduction);
+        }
+    }
+}
+
+std::vector<std::vector<uint8_t>> LoopAnalyzer::feasibleDirections(const ArrayAccess& first, int firstDepth,
+                                                                   const ArrayAccess& second, int secondDepth) const {
+    NormalizedSubscript firstRow = normalize(first.row, firstDepth, nest.loops);
+    NormalizedSubscript firstCol = normalize(first.col, firstDepth, nest.loops);
+    NormalizedSubscript secondRow = normalize(second.row, secondDepth, nest.loops);
+    NormalizedSubscript secondCol = normalize(second.col, secondDepth, nest.loops);
+    int common = std::min(firstDepth, secondDepth);
     
-    Loop jLoop;
-    jLoop.startIdx = 0;
-    jLoop.endIdx = code.size() - 1;
-    jLoop.nestLevel = 1;
-    jLoop.inductionVar = "j";
-    jLoop.lowerBound = 0;
-    jLoop.upperBound = 2;
-    jLoop.step = 1;
-    jLoop.isParallelizable = true;  // Middle loop can be parallelized
+    // Refine the direction vector one level at a time, pruning as soon as a
+    // prefix (with the remaining levels left as '*') cannot alias
+    std::vector<std::vector<uint8_t>> feasible;
+    std::vector<uint8_t> directions(common, Direction::ALL);
+    std::function<void(int)> refine = [&](int level) {
+        if (!subscriptMayAlias(firstRow, secondRow, directions, nest.loops) ||
+            !subscriptMayAlias(firstCol, secondCol, directions, nest.loops)) {
+            return;
+        }
+        if (level == common) {
+            feasible.push_back(directions);
+            return;
+        }
+        for (uint8_t direction : {Direction::LT, Direction::EQ, Direction::GT}) {
+            directions[level] = direction;
+            refine(level + 1);
+        }
+        directions[level] = Direction::ALL;
+    };
+    refine(0);
     
-    Loop kLoop;
-    kLoop.startIdx = 0;
-    kLoop.endIdx = code.size() - 1;
-    kLoop.nestLevel = 2;
-    kLoop.inductionVar = "k";
-    kLoop.lowerBound = 0;
-    kLoop.upperBound = 2;
-    kLoop.step = 1;
-    kLoop.isParallelizable = false;  // Innermost loop has dependencies
+    return feasible;
+}
+
+void LoopAnalyzer::analyzeDependences() {
+    dependences.clear();
+    
+    // Instructions at the same iteration run in body order
+    assert(nest.isInProgramOrder());
+    
+    // Array references of the body: (instruction, operand, is write)
+    struct Reference {
+        int inst;
+        const Operand* operand;
+        bool isWrite;
+    };
+    std::vector<Reference> references;
+    for (int i = 0; i < nest.body.size(); i++) {
+        const auto& inst = nest.body[i];
+        if (inst.dest.kind == Operand::Kind::ARRAY) {
+            references.push_back({i, &inst.dest, true});
+        }
+        for (const Operand* operand : {&inst.src1, &inst.src2}) {
+            if (operand->kind == Operand::Kind::ARRAY) {
+                references.push_back({i, operand, false});
+            }
+        }
+    }
+    
+    auto inReduction = [&](int inst, int level) {
+        for (const auto& reduction : reductions) {
+            if ((inst == reduction.load || inst == reduction.store) &&
+                std::find(reduction.loops.begin(), reduction.loops.end(), level) != reduction.loops.end()) {
+                return true;
+            }
+        }
+        return false;
+    };
     
-    loops.push_back(iLoop);
-    loops.push_back(jLoop);
-    loops.push_back(kLoop);
+    for (const auto& source : references) {
+        for (const auto& sink : references) {
+            const ArrayAccess& sourceAccess = nest.accesses[source.operand->id];
+            const ArrayAccess& sinkAccess = nest.accesses[sink.operand->id];
+            if ((!source.isWrite && !sink.isWrite) || sourceAccess.array != sinkAccess.array) {
+                continue;
+            }
+            int sourceDepth = nest.body[source.inst].depth;
+            int sinkDepth = nest.body[sink.inst].depth;
+            int common = std::min(sourceDepth, sinkDepth);
+            
+            // Keep the vectors where the source really runs first: the first
+            // non-'=' level is '<', or all are '=' and the source comes first in the body
+            Dependence dependence;
+            dependence.directions.assign(common, 0);
+            bool found = false;
+            for (const auto& vector : feasibleDirections(sourceAccess, sourceDepth, sinkAccess, sinkDepth)) {
+                int level = 0;
+                while (level < common && vector[level] == Direction::EQ) {
+                    level++;
+                }
+                if (level < common ? vector[level] != Direction::LT : source.inst >= sink.inst) {
+                    continue;
+                }
+                found = true;
+                for (int d = 0; d < common; d++) {
+                    dependence.directions[d] |= vector[d];
+                }
+                if (level < common &&
+                    std::find(dependence.carriedBy.begin(), dependence.carriedBy.end(), level) == dependence.carriedBy.end()) {
+                    dependence.carriedBy.push_back(level);
+                }
+            }
+            if (!found) {
+                continue;
+            }
+            std::sort(dependence.carriedBy.begin(), dependence.carriedBy.end());
+            
+            dependence.kind = source.isWrite ? (sink.isWrite ? Dependence::Kind::OUTPUT : Dependence::Kind::FLOW)
+                                             : Dependence::Kind::ANTI;
+            dependence.source = source.inst;
+            dependence.sink = sink.inst;
+            
+            // Exact distance where a subscript uses a single loop with the same
+            // coefficient on both sides (strong SIV)
+            NormalizedSubscript subscripts[2][2] = {
+                {normalize(sourceAccess.row, sourceDepth, nest.loops), normalize(sinkAccess.row, sinkDepth, nest.loops)},
+                {normalize(sourceAccess.col, sourceDepth, nest.loops), normalize(sinkAccess.col, sinkDepth, nest.loops)}};
+            dependence.distances.assign(common, Dependence::UNKNOWN_DISTANCE);
+            for (int d = 0; d < common; d++) {
+                if (dependence.directions[d] == Direction::EQ) {
+                    dependence.distances[d] = 0;
+                    continue;
+                }
+                for (const auto& pair : subscripts) {
+                    const auto& first = pair[0];
+                    const auto& second = pair[1];
+                    bool singleLoop = first.coeffs[d] != 0 && first.coeffs[d] == second.coeffs[d];
+                    for (size_t e = 0; e < first.coeffs.size() && singleLoop; e++) {
+                        singleLoop = e == static_cast<size_t>(d) || first.coeffs[e] == 0;
+                    }
+                    for (size_t e = 0; e < second.coeffs.size() && singleLoop; e++) {
+                        singleLoop = e == static_cast<size_t>(d) || second.coeffs[e] == 0;
+                    }
+                    if (singleLoop) {
+                        dependence.distances[d] = (first.constant - second.constant) / first.coeffs[d];
+                    }
+                }
+            }
+            
+            // A reduction's own load/store pair only depends on itself across the reduction loops
+            dependence.isReduction = !dependence.carriedBy.empty();
+            for (int level : dependence.carriedBy) {
+                if (!inReduction(source.inst, level) || !inReduction(sink.inst, level)) {
+                    dependence.isReduction = false;
+                }
+            }
+            
+            dependences.push_back(dependence);
+        }
+    }
 }
 
 void LoopAnalyzer::analyzeParallelizability() {
     // For each loop, determine if it can be parallelized
     for (auto& loop : loops) {
-        // Check for loop-carried dependencies
+        // Check for loop-carried dependencies, setting reductions apart
         bool hasLoopCarriedDependency = false;
+        bool carriesReduction = false;
         
-        // In a real implementation, this would analyze the dependency graph
-        // to determine if there are dependencies across loop iterations
-        
-        // For this example, we'll use our knowledge of matrix multiplication:
-        // - The i and j loops can be parallelized
-        // - The k loop has loop-carried dependencies due to accumulation
-        
-        if (loop.inductionVar == "k") {
-            hasLoopCarriedDependency = true;
+        for (const auto& dependence : dependences) {
+            if (std::find(dependence.carriedBy.begin(), dependence.carriedBy.end(), loop.nestLevel) ==
+                dependence.carriedBy.end()) {
+                continue;
+            }
+            if (dependence.isReduction) {
+                carriesReduction = true;
+            } else {
+                hasLoopCarriedDependency = true;
+            }
         }
         
-        loop.isParallelizable = !hasLoopCarriedDependency;
+        loop.isParallelizable = !hasLoopCarriedDependency && !carriesReduction;
+        loop.isReduction = !hasLoopCarriedDependency && carriesReduction;
     }
 }
 
@@ -121,6 +448,14 @@ std::vector<Loop> LoopAnalyzer::getParallelizableLoops() const {
     return parallelizableLoops;
 }
 
-const std::map<int, std::vector<int>>& LoopAnalyzer::getDependencyGraph() const {
-    return dependencyGraph;
+const std::vector<Dependence>& LoopAnalyzer::getDependences() const {
+    return dependences;
+}
+
+const std::vector<Reduction>& LoopAnalyzer::getReductions() const {
+    return reductions;
+}
+
+DependencyGraphView LoopAnalyzer::getDependencyGraph() const {
+    return DependencyGraphView(dependencyOffsets.data(), dependencyEdges.data(), dependencyOffsets.size() - 1);
 }
\ No newline at end of file
@@ -1,25 +1,98 @@
 #ifndef LOOP_ANALYZER_H
 #define LOOP_ANALYZER_H
 
-#include "parser.h"
+#include "loop_nest.h"
 #include <vector>
-#include <map>
+#include <climits>
+#include <cstdint>
 
 // Represents a loop in the code
 struct Loop {
-    int startIdx;  // Start index in the three-address code
-    int endIdx;    // End index in the three-address code
+    int startIdx;  // Index of the first body instruction inside the loop
+    int endIdx;    // Index of the last body instruction inside the loop
     int nestLevel; // Nesting level (0 = outermost)
     std::string inductionVar; // Loop induction variable
     int lowerBound; // Loop lower bound
     int upperBound; // Loop upper bound
     int step;       // Loop step
     bool isParallelizable; // Whether the loop can be parallelized
+    bool isReduction;      // Whether the only dependences it carries are reductions
+    int tileSize;          // Iterations per tile; the trip count when the loop is not tiled
+};
+
+// Direction of a dependence at one loop level, as a mask of the possible
+// orderings of the source and sink iterations
+namespace Direction {
+    constexpr uint8_t LT = 0x1;  // Sink runs in a later iteration (<)
+    constexpr uint8_t EQ = 0x2;  // Same iteration (=)
+    constexpr uint8_t GT = 0x4;  // Sink runs in an earlier iteration (>)
+    constexpr uint8_t ALL = LT | EQ | GT;  // Any ordering (*)
+}
+
+// A dependence between two accesses to the same array in the loop body
+struct Dependence {
+    enum class Kind { FLOW, ANTI, OUTPUT };
+    
+    static constexpr int UNKNOWN_DISTANCE = INT_MIN;
+    
+    Kind kind;
+    int source;  // Body index of the instruction accessing first
+    int sink;    // Body index of the instruction accessing second
+    std::vector<uint8_t> directions;  // Direction mask per common loop, outermost first
+    std::vector<int> distances;       // Sink minus source iteration per common loop
+    std::vector<int> carriedBy;       // Loop levels carrying it; empty if loop-independent
+    bool isReduction;                 // Part of a recognised reduction
+    
+    std::string directionString() const;
+    std::string distanceString() const;
+};
+
+// A reduction in the loop body: X[f] = X[f] op value, where f is invariant
+// in the loops the reduction runs over
+struct Reduction {
+    int load;    // Body index of the load of the accumulator
+    int update;  // Body index of the ADD/MULTIPLY combining it with the value
+    int store;   // Body index of the store back to the accumulator
+    int access;  // Access function of the accumulator
+    ThreeAddressInst::OpType op;
+    std::vector<int> loops;  // Levels of the loops the reduction runs over
+};
+
+// Read-only view of a dependency graph in compressed sparse row form: the
+// instructions that instruction i depends on are edges[offsets[i] .. offsets[i + 1])
+class DependencyGraphView {
+public:
+    // Contiguous run of instruction indices
+    struct Range {
+        const int* first;
+        const int* last;
+        
+        const int* begin() const { return first; }
+        const int* end() const { return last; }
+        int size() const { return last - first; }
+    };
+    
+    DependencyGraphView(const int* offsets, const int* edges, int count)
+        : offsets(offsets), edges(edges), count(count) {}
+    
+    // Number of instructions in the graph
+    int size() const { return count; }
+    
+    // Total number of dependency edges
+    int edgeCount() const { return count > 0 ? offsets[count] : 0; }
+    
+    // Instructions that an instruction depends on
+    Range dependencies(int inst) const { return {edges + offsets[inst], edges + offsets[inst + 1]}; }
+    
+private:
+    const int* offsets;
+    const int* edges;
+    int count;
 };
 
 class LoopAnalyzer {
 public:
-    LoopAnalyzer(const std::vector<ThreeAddressInst>& code);
+    LoopAnalyzer(const LoopNest& nest);
     
     // Analyze the code to identify loops and their properties
     void analyze();
@@ -30,18 +103,29 @@ public:
     // Get the parallelizable loops
     std::vector<Loop> getParallelizableLoops() const;
     
+    // Get the dependences between array accesses of the body
+    const std::vector<Dependence>& getDependences() const;
+    
+    // Get the reductions recognised in the body
+    const std::vector<Reduction>& getReductions() const;
+    
     // Get the dependency graph for the code
-    const std::map<int, std::vector<int>>& getDependencyGraph() const;
+    DependencyGraphView getDependencyGraph() const;
     
 private:
-    // The three-address code to analyze
-    const std::vector<ThreeAddressInst>& code;
+    // The loop nest to analyze
+    const LoopNest& nest;
     
     // Identified loops
     std::vector<Loop> loops;
     
-    // Dependency graph (instruction index -> dependent instruction indices)
-    std::map<int, std::vector<int>> dependencyGraph;
+    // Array dependences and reductions
+    std::vector<Dependence> dependences;
+    std::vector<Reduction> reductions;
+    
+    // Dependency graph in CSR form (instruction index -> instructions it depends on)
+    std::vector<int> dependencyOffsets;
+    std::vector<int> dependencyEdges;
     
     // Build the dependency graph
     void buildDependencyGraph();
@@ -49,6 +133,16 @@ private:
     // Identify loops in the code
     void identifyLoops();
     
+    // Recognise X[f] = X[f] op value reductions in the body
+    void findReductions();
+    
+    // Test every pair of accesses to the same array for dependences
+    void analyzeDependences();
+    
+    // Find the direction vectors under which two accesses can touch the same element
+    std::vector<std::vector<uint8_t>> feasibleDirections(const ArrayAccess& first, int firstDepth,
+                                                         const ArrayAccess& second, int secondDepth) const;
+    
     // Analyze loop parallelizability
     void analyzeParallelizability();
 };
@@ -0,0 +1,128 @@
+#include "loop_compressor.h"
+#include <iostream>
+
+long LoopCompressor::countIterations(const std::vector<PimInstruction>& instructions, size_t start, int length,
+                                     std::vector<PimInstruction>& body) {
+    if (start + 2 * length > instructions.size()) {
+        return 1;
+    }
+    
+    // The second iteration fixes the strides
+    for (int k = 0; k < length; k++) {
+        const auto& first = instructions[start + k];
+        const auto& second = instructions[start + length + k];
+        int rowStride = second.row_addr - first.row_addr;
+        int colStride = second.col_addr - first.col_addr;
+        if (second.opcode != first.opcode || second.core_id != first.core_id || second.flags != first.flags ||
+            rowStride < minStride || rowStride > maxStride || colStride < minStride || colStride > maxStride) {
+            return 1;
+        }
+    }
+    body.assign(instructions.begin() + start, instructions.begin() + start + length);
+    for (int k = 0; k < length; k++) {
+        body[k].row_stride = instructions[start + length + k].row_addr - body[k].row_addr;
+        body[k].col_stride = instructions[start + length + k].col_addr - body[k].col_addr;
+    }
+    
+    // and the following iterations must keep to them
+    long iterations = 2;
+    while (iterations < UINT16_MAX && start + (iterations + 1) * length <= instructions.size()) {
+        size_t next = start + iterations * length;
+        for (int k = 0; k < length; k++) {
+            const auto& inst = instructions[next + k];
+            if (inst.opcode != body[k].opcode || inst.core_id != body[k].core_id || inst.flags != body[k].flags ||
+                inst.row_addr != static_cast<uint16_t>(body[k].row_addr + iterations * body[k].row_stride) ||
+                inst.col_addr != static_cast<uint16_t>(body[k].col_addr + iterations * body[k].col_stride)) {
+                return iterations;
+            }
+        }
+        iterations++;
+    }
+    return iterations;
+}
+
+std::vector<PimInstruction> LoopCompressor::compress(const std::vector<PimInstruction>& instructions) {
+    std::vector<PimInstruction> program;
+    std::vector<PimInstruction> body;
+    std::vector<PimInstruction> bestBody;
+    loops = 0;
+    
+    size_t position = 0;
+    while (position < instructions.size()) {
+        // A loop of t iterations of an L-instruction body replaces t * L
+        // instructions with L + 1
+        long bestSaving = 0;
+        long bestIterations = 0;
+        for (int length = 1; length <= maxBody && position + 2 * length <= instructions.size(); length++) {
+            if (instructions[position + length].opcode != instructions[position].opcode) {
+                continue;
+            }
+            long iterations = countIterations(instructions, position, length, body);
+            long saving = (iterations - 1) * length - 1;
+            if (saving > bestSaving) {
+                bestSaving = saving;
+                bestIterations = iterations;
+                bestBody.swap(body);
+            }
+        }
+        
+        if (bestSaving <= 0) {
+            program.push_back(instructions[position++]);
+            continue;
+        }
+        PimInstruction repeatInst;
+        repeatInst.opcode = Opcode::REPEAT;
+        repeatInst.core_id = 0;
+        repeatInst.row_addr = bestIterations;
+        repeatInst.col_addr = bestBody.size();
+        repeatInst.flags = 0;
+        program.push_back(repeatInst);
+        program.insert(program.end(), bestBody.begin(), bestBody.end());
+        position += bestIterations * bestBody.size();
+        loops++;
+    }
+    return program;
+}
+
+bool LoopCompressor::expand(const std::vector<PimInstruction>& program, std::vector<PimInstruction>& instructions) {
+    instructions.clear();
+    for (size_t i = 0; i < program.size(); i++) {
+        const auto& inst = program[i];
+        if (inst.opcode != Opcode::REPEAT) {
+            if (inst.row_stride != 0 || inst.col_stride != 0) {
+                std::cerr << "Stride outside a loop at instruction " << i << std::endl;
+                return false;
+            }
+            instructions.push_back(inst);
+            continue;
+        }
+        
+        size_t length = inst.col_addr;
+        if (i + length >= program.size()) {
+            std::cerr << "Loop at instruction " << i << " runs past the end" << std::endl;
+            return false;
+        }
+        for (size_t k = 1; k <= length; k++) {
+            if (program[i + k].opcode == Opcode::REPEAT) {
+                std::cerr << "Nested loop at instruction " << i + k << std::endl;
+                return false;
+            }
+        }
+        for (long t = 0; t < inst.row_addr; t++) {
+            for (size_t k = 1; k <= length; k++) {
+                PimInstruction expanded = program[i + k];
+                expanded.row_addr += t * expanded.row_stride;
+                expanded.col_addr += t * expanded.col_stride;
+                expanded.row_stride = 0;
+                expanded.col_stride = 0;
+                instructions.push_back(expanded);
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+long LoopCompressor::getLoops() const {
+    return loops;
+}
\ No newline at end of file
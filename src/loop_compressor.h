@@ -0,0 +1,40 @@
+#ifndef LOOP_COMPRESSOR_H
+#define LOOP_COMPRESSOR_H
+
+#include "../include/pim_isa.h"
+#include <vector>
+
+// Encodes runs of instructions that repeat with constant address strides as
+// REPEAT loops. A REPEAT (row = iteration count, col = body length) runs the
+// body that follows it once per iteration; each body instruction carries the
+// row and column stride it advances by, so at iteration t it accesses its
+// row and column plus t times its stride. Bodies do not nest.
+class LoopCompressor {
+public:
+    // Compress a flat program, choosing at every position the loop that
+    // saves the most instructions
+    std::vector<PimInstruction> compress(const std::vector<PimInstruction>& instructions);
+    
+    // Expand a compressed program back into the flat one; fails on a loop
+    // running past the end, a nested loop or a stride outside a loop
+    static bool expand(const std::vector<PimInstruction>& program, std::vector<PimInstruction>& instructions);
+    
+    // Get the number of loops in the last compressed program
+    long getLoops() const;
+    
+    // Longest loop body tried, and the range of a stride
+    static constexpr int maxBody = 256;
+    static constexpr int minStride = -32;
+    static constexpr int maxStride = 31;
+    
+private:
+    long loops = 0;
+    
+    // Number of iterations of a loop with the given body length starting at
+    // position start (1 if the next iteration does not follow the first),
+    // with the strides of the body instructions
+    static long countIterations(const std::vector<PimInstruction>& instructions, size_t start, int length,
+                                std::vector<PimInstruction>& body);
+};
+
+#endif // LOOP_COMPRESSOR_H
\ No newline at end of file
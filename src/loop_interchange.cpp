@@ -0,0 +1,182 @@
+#include "loop_interchange.h"
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+// Directions between the iterations of a loop at which two instructions run,
+// for a loop that does not enclose both. An instruction outside the loop runs
+// at its first iteration if it comes before the loop and at its last if it
+// comes after it, as the generator places it.
+uint8_t placementDirection(const ThreeAddressInst& source, const ThreeAddressInst& sink,
+                           int level, int lastIteration) {
+    auto iterations = [&](const ThreeAddressInst& inst) {
+        if (level < inst.depth) {
+            return std::make_pair(0, lastIteration);
+        }
+        return inst.afterInner ? std::make_pair(lastIteration, lastIteration) : std::make_pair(0, 0);
+    };
+    auto first = iterations(source);
+    auto second = iterations(sink);
+    uint8_t direction = 0;
+    if (first.first < second.second) {
+        direction |= Direction::LT;
+    }
+    if (first.first <= second.second && second.first <= first.second) {
+        direction |= Direction::EQ;
+    }
+    if (first.second > second.first) {
+        direction |= Direction::GT;
+    }
+    return direction;
+}
+
+} // namespace
+
+LoopInterchange::LoopInterchange(const LoopNest& nest, const std::vector<Loop>& loops,
+                                 const std::vector<Dependence>& dependences,
+                                 const MemoryMapper& memoryMapper, const TargetConfig& target)
+    : nest(nest), loops(loops), dependences(dependences), memoryMapper(memoryMapper), target(target) {
+}
+
+std::vector<int> LoopInterchange::chooseOrder() {
+    std::vector<int> order(loops.size());
+    std::iota(order.begin(), order.end(), 0);
+    
+    // Orders that would leave fewer parallel loops outermost than the source
+    // are not considered, so interchange never takes work away from the
+    // cores. A second one stays outermost when the first has fewer
+    // iterations than there are cores to spread them over.
+    int keptParallel = 0;
+    long iterations = 1;
+    while (keptParallel < std::min<int>(loops.size(), 2) && loops[keptParallel].isParallelizable &&
+           (keptParallel == 0 || iterations < target.cores)) {
+        const Loop& loop = loops[keptParallel];
+        iterations *= (loop.upperBound - loop.lowerBound) / loop.step + 1;
+        keptParallel++;
+    }
+    
+    std::vector<int> best = order;
+    double bestCost = estimateActivations(order);
+    while (std::next_permutation(order.begin(), order.end())) {
+        bool keepsParallel = true;
+        for (int p = 0; p < keptParallel; p++) {
+            keepsParallel = keepsParallel && loops[order[p]].isParallelizable;
+        }
+        if (!keepsParallel) {
+            continue;
+        }
+        if (!isLegal(order)) {
+            continue;
+        }
+        double cost = estimateActivations(order);
+        if (cost < bestCost) {
+            best = order;
+            bestCost = cost;
+        }
+    }
+    return best;
+}
+
+void LoopInterchange::setConstantMatrix(int matrix) {
+    constantMatrix = matrix;
+}
+
+bool LoopInterchange::isLegal(const std::vector<int>& order) const {
+    // A dependence is preserved if, taking its directions in the new order,
+    // the first level that is not '=' can only be '<'. At levels that are not
+    // common to both accesses, an instruction before or after the nested loop
+    // is pinned to its first or last iteration, so moving such a loop outward
+    // reorders it against the other instruction's iterations.
+    for (const auto& dependence : dependences) {
+        for (int level : order) {
+            uint8_t direction;
+            if (level < static_cast<int>(dependence.directions.size())) {
+                direction = dependence.directions[level];
+            } else {
+                const Loop& loop = loops[level];
+                direction = placementDirection(nest.body[dependence.source], nest.body[dependence.sink], level,
+                                               (loop.upperBound - loop.lowerBound) / loop.step);
+            }
+            if (direction & Direction::GT) {
+                return false;
+            }
+            if (direction == Direction::LT) {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+double LoopInterchange::estimateActivations(const std::vector<int>& order) const {
+    int depth = loops.size();
+    
+    // Replay the first sampleIterations iterations of every loop in this
+    // order. Each subarray keeps one row open; an access to another row of
+    // it activates that row. Temporaries cost the same in every order and
+    // statements outside the innermost loop run once per outer iteration
+    // whatever the order, so only the innermost array accesses are replayed.
+    std::vector<int> iterators(depth);
+    std::unordered_map<int, int> openRows;
+    long activations = 0;
+    long lutPrograms = 0;
+    long lastConstant = -1;
+    double samplePoints = 1;
+    double totalPoints = 1;
+    for (const auto& loop : loops) {
+        int tripCount = (loop.upperBound - loop.lowerBound) / loop.step + 1;
+        samplePoints *= std::min(tripCount, sampleIterations);
+        totalPoints *= tripCount;
+    }
+    
+    auto access = [&](const Operand& operand) {
+        if (operand.kind != Operand::Kind::ARRAY) {
+            return;
+        }
+        const auto& arrayAccess = nest.accesses[operand.id];
+        int matrix = arrayAccess.array;
+        if (matrix == constantMatrix) {
+            long element = static_cast<long>(arrayAccess.row.evaluate(iterators)) * nest.arrays[arrayAccess.array].cols +
+                           arrayAccess.col.evaluate(iterators);
+            if (element != lastConstant) {
+                lutPrograms++;
+                lastConstant = element;
+            }
+            return;
+        }
+        int row = memoryMapper.getMatrixElementLocation(matrix, arrayAccess.row.evaluate(iterators),
+                                                        arrayAccess.col.evaluate(iterators)).row;
+        auto it = openRows.find(row / target.rowsPerSubarray);
+        if (it == openRows.end() || it->second != row) {
+            openRows[row / target.rowsPerSubarray] = row;
+            activations++;
+        }
+    };
+    
+    std::function<void(int)> walk = [&](int position) {
+        if (position == depth) {
+            for (const auto& inst : nest.body) {
+                if (inst.depth == depth) {
+                    access(inst.src1);
+                    access(inst.src2);
+                    access(inst.dest);
+                }
+            }
+            return;
+        }
+        const Loop& loop = loops[order[position]];
+        int tripCount = (loop.upperBound - loop.lowerBound) / loop.step + 1;
+        for (int t = 0; t < std::min(tripCount, sampleIterations); t++) {
+            iterators[order[position]] = loop.lowerBound + t * loop.step;
+            walk(position + 1);
+        }
+    };
+    walk(0);
+    
+    // A LUT takes as long to program as this many row activations
+    double lutCost = static_cast<double>(target.lutLatency) / std::max(1, target.loadLatency);
+    return (activations + lutPrograms * lutCost) * (totalPoints / samplePoints);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef LOOP_INTERCHANGE_H
+#define LOOP_INTERCHANGE_H
+
+#include "loop_nest.h"
+#include "loop_analyzer.h"
+#include "memory_mapper.h"
+#include "target_config.h"
+#include <vector>
+
+// Chooses the order in which the loops of the nest run. Every legal
+// permutation is scored by the DRAM row activations its array accesses cause
+// under the memory mapper's layout, and the cheapest one is kept. The
+// elements of a constant matrix are not loaded but reprogram the LUT, which
+// is counted as the row activations taking as long.
+class LoopInterchange {
+public:
+    LoopInterchange(const LoopNest& nest, const std::vector<Loop>& loops,
+                    const std::vector<Dependence>& dependences,
+                    const MemoryMapper& memoryMapper, const TargetConfig& target);
+    
+    // Choose the loop order, outermost first, as levels of the original nest
+    std::vector<int> chooseOrder();
+    
+    // Take a matrix as constant: multiplies by its elements reprogram the LUT
+    // whenever the element changes
+    void setConstantMatrix(int matrix);
+    
+    // Check that running the loops in this order preserves every dependence
+    bool isLegal(const std::vector<int>& order) const;
+    
+    // Estimate the row activations of the whole iteration space in this
+    // order, with the LUT reprogrammings for a constant matrix
+    double estimateActivations(const std::vector<int>& order) const;
+    
+private:
+    const LoopNest& nest;
+    const std::vector<Loop>& loops;
+    const std::vector<Dependence>& dependences;
+    const MemoryMapper& memoryMapper;
+    const TargetConfig& target;
+    
+    // Matrix whose values are known, or -1
+    int constantMatrix = -1;
+    
+    // Iterations per loop replayed by the cost model
+    static constexpr int sampleIterations = 32;
+};
+
+#endif // LOOP_INTERCHANGE_H
\ No newline at end of file
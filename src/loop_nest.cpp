@@ -0,0 +1,148 @@
+#include "loop_nest.h"
+#include <sstream>
+
+namespace {
+
+// Render an affine subscript such as "i", "2*k+1" or "0"
+std::string affineToString(const AffineIndex& index, const std::vector<LoopBounds>& loops) {
+    std::string result;
+    for (size_t d = 0; d < index.coeffs.size() && d < loops.size(); d++) {
+        int coeff = index.coeffs[d];
+        if (coeff == 0) {
+            continue;
+        }
+        if (coeff < 0) {
+            result += "-";
+        } else if (!result.empty()) {
+            result += "+";
+        }
+        if (coeff != 1 && coeff != -1) {
+            result += std::to_string(coeff < 0 ? -coeff : coeff) + "*";
+        }
+        result += loops[d].inductionVar;
+    }
+    if (index.constant != 0 || result.empty()) {
+        if (index.constant >= 0 && !result.empty()) {
+            result += "+";
+        }
+        result += std::to_string(index.constant);
+    }
+    return result;
+}
+
+} // namespace
+
+int AffineIndex::evaluate(const std::vector<int>& iterators) const {
+    int value = constant;
+    for (size_t d = 0; d < coeffs.size() && d < iterators.size(); d++) {
+        value += coeffs[d] * iterators[d];
+    }
+    return value;
+}
+
+bool AffineIndex::operator==(const AffineIndex& other) const {
+    return coeffs == other.coeffs && constant == other.constant;
+}
+
+Operand LoopNest::newTemp() {
+    Operand operand;
+    operand.kind = Operand::Kind::TEMP;
+    operand.id = tempCount++;
+    operand.symbol = symbols.intern(operandToString(operand));
+    return operand;
+}
+
+Operand LoopNest::addAccess(const ArrayAccess& access) {
+    Operand operand;
+    operand.kind = Operand::Kind::ARRAY;
+    operand.id = accesses.size();
+    for (size_t i = 0; i < accesses.size(); i++) {
+        if (accesses[i].array == access.array && accesses[i].row == access.row &&
+            accesses[i].col == access.col) {
+            operand.id = i;
+            break;
+        }
+    }
+    if (operand.id == static_cast<int>(accesses.size())) {
+        accesses.push_back(access);
+    }
+    operand.symbol = symbols.intern(operandToString(operand));
+    return operand;
+}
+
+Operand LoopNest::constant(int value) {
+    Operand operand;
+    operand.kind = Operand::Kind::CONSTANT;
+    operand.id = value;
+    return operand;
+}
+
+std::string LoopNest::operandToString(const Operand& operand) const {
+    switch (operand.kind) {
+        case Operand::Kind::TEMP:
+            return "t" + std::to_string(operand.id);
+        case Operand::Kind::ARRAY: {
+            const auto& access = accesses[operand.id];
+            return arrays[access.array].name + "[" + affineToString(access.row, loops) + "][" +
+                   affineToString(access.col, loops) + "]";
+        }
+        case Operand::Kind::CONSTANT:
+            return std::to_string(operand.id);
+        default:
+            return "";
+    }
+}
+
+std::string LoopNest::toString(const ThreeAddressInst& inst) const {
+    std::string dest = operandToString(inst.dest);
+    std::string src1 = operandToString(inst.src1);
+    std::string src2 = operandToString(inst.src2);
+    
+    std::string result;
+    switch (inst.op) {
+        case ThreeAddressInst::OpType::LOAD: result = dest + " = LOAD " + src1; break;
+        case ThreeAddressInst::OpType::STORE: result = "STORE " + src1 + " to " + dest; break;
+        case ThreeAddressInst::OpType::ADD: result = dest + " = " + src1 + " + " + src2; break;
+        case ThreeAddressInst::OpType::MULTIPLY: result = dest + " = " + src1 + " * " + src2; break;
+        case ThreeAddressInst::OpType::MOVE: result = dest + " = " + src1; break;
+    }
+    return result;
+}
+
+std::string LoopNest::toString() const {
+    std::ostringstream out;
+    
+    // Body instructions are in program order, so opening a loop means printing
+    // everything deeper than it before the instructions placed after it
+    size_t next = 0;
+    for (size_t level = 0; level <= loops.size(); level++) {
+        std::string indent(2 * level, ' ');
+        while (next < body.size() && body[next].depth == static_cast<int>(level) && !body[next].afterInner) {
+            out << indent << toString(body[next++]) << std::endl;
+        }
+        if (level < loops.size()) {
+            const auto& loop = loops[level];
+            out << indent << "for " << loop.inductionVar << " = " << loop.lowerBound << " to "
+                << loop.upperBound << " step " << loop.step << std::endl;
+        }
+    }
+    for (; next < body.size(); next++) {
+        out << std::string(2 * body[next].depth, ' ') << toString(body[next]) << std::endl;
+    }
+    
+    return out.str();
+}
+
+bool LoopNest::isInProgramOrder() const {
+    // Levels open outermost first and close innermost first
+    int depth = static_cast<int>(loops.size());
+    int previous = 0;
+    for (const auto& inst : body) {
+        int position = inst.afterInner ? 2 * depth - inst.depth : inst.depth;
+        if (position < previous) {
+            return false;
+        }
+        previous = position;
+    }
+    return true;
+}
\ No newline at end of file
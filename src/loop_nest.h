@@ -0,0 +1,107 @@
+#ifndef LOOP_NEST_H
+#define LOOP_NEST_H
+
+#include <string>
+#include <vector>
+#include "symbol_table.h"
+
+// A loop of the kernel's loop nest, recovered with LoopInfo/ScalarEvolution
+struct LoopBounds {
+    std::string inductionVar; // Name given to the induction variable (i, j, k, ...)
+    int depth;                // Nesting level (0 = outermost)
+    int lowerBound;           // First value of the induction variable
+    int upperBound;           // Last value of the induction variable (inclusive)
+    int step;                 // Induction variable increment
+    int tripCount;            // Number of iterations
+};
+
+// An array accessed by the kernel
+struct ArrayShape {
+    std::string name;
+    int rows;
+    int cols;
+    int elementSize;  // Size of one element in bytes
+};
+
+// Affine function of the loop induction variables: constant + sum(coeffs[d] * iv[d])
+struct AffineIndex {
+    std::vector<int> coeffs;  // One coefficient per loop depth
+    int constant = 0;
+    
+    int evaluate(const std::vector<int>& iterators) const;
+    
+    bool operator==(const AffineIndex& other) const;
+};
+
+// Access function array[row][col] with affine subscripts
+struct ArrayAccess {
+    int array;  // Index into LoopNest::arrays
+    AffineIndex row;
+    AffineIndex col;
+};
+
+// Operand of a three-address instruction
+struct Operand {
+    enum class Kind { NONE, TEMP, ARRAY, CONSTANT };
+    
+    Kind kind = Kind::NONE;
+    int id = 0;       // Temporary number, index into LoopNest::accesses, or constant value
+    int symbol = -1;  // Interned name in LoopNest::symbols; -1 for constants
+};
+
+// Represents a three-address instruction of the loop body. Operands stay
+// symbolic: temporaries are per-iteration values and array operands are
+// access functions evaluated at code generation time.
+struct ThreeAddressInst {
+    enum class OpType {
+        LOAD,
+        STORE,
+        ADD,
+        MULTIPLY,
+        MOVE
+    };
+    
+    OpType op;
+    Operand dest;
+    Operand src1;
+    Operand src2;     // Unused for LOAD/STORE/MOVE
+    int depth;        // Number of enclosing loops
+    bool afterInner;  // Placed after the loop nested at its level rather than before it
+};
+
+// Affine loop nest: loop bounds, the arrays and access functions, and the
+// three-address body, in program order
+struct LoopNest {
+    std::vector<LoopBounds> loops;
+    std::vector<ArrayShape> arrays;
+    std::vector<ArrayAccess> accesses;
+    std::vector<ThreeAddressInst> body;
+    int tempCount = 0;
+    
+    // Names of temporaries and access functions; an operand's symbol indexes it
+    SymbolTable symbols;
+    
+    // Create a fresh temporary
+    Operand newTemp();
+    
+    // Register an access function, sharing the operand of an identical one
+    Operand addAccess(const ArrayAccess& access);
+    
+    // Make a constant operand
+    static Operand constant(int value);
+    
+    // Name of an operand, e.g. "t2", "A[i][k]" or "0"
+    std::string operandToString(const Operand& operand) const;
+    
+    // Human-readable form of one body instruction
+    std::string toString(const ThreeAddressInst& inst) const;
+    
+    // Human-readable form of the whole nest
+    std::string toString() const;
+    
+    // Whether the body runs in list order: each level's leading
+    // instructions, the nested level, then the level's trailing instructions
+    bool isInProgramOrder() const;
+};
+
+#endif // LOOP_NEST_H
\ No newline at end of file
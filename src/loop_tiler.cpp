@@ -0,0 +1,161 @@
+#include "loop_tiler.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <tuple>
+
+namespace {
+
+// Coefficients of a subscript padded to the depth of the nest
+std::vector<int> paddedCoeffs(const AffineIndex& index, int depth) {
+    std::vector<int> coeffs(index.coeffs.begin(), index.coeffs.begin() + std::min<size_t>(index.coeffs.size(), depth));
+    coeffs.resize(depth, 0);
+    return coeffs;
+}
+
+// Number of distinct values a subscript takes over a tile
+long subscriptSpan(const std::vector<int>& coeffs, int constantSpan, const std::vector<int>& tileSizes,
+                   const std::vector<LoopBounds>& loops, int extent) {
+    long span = 1 + constantSpan;
+    for (size_t d = 0; d < coeffs.size(); d++) {
+        span += std::abs(static_cast<long>(coeffs[d]) * loops[d].step) * (tileSizes[d] - 1);
+    }
+    return std::min<long>(span, extent);
+}
+
+} // namespace
+
+LoopTiler::LoopTiler(const LoopNest& nest, const std::vector<Dependence>& dependences,
+                     const TargetConfig& target, const MemoryMapper& memoryMapper)
+    : nest(nest), dependences(dependences), target(target), memoryMapper(memoryMapper) {
+}
+
+void LoopTiler::tile(std::vector<Loop>& loops) {
+    int depth = nest.loops.size();
+    bandDepth = findPermutableBand();
+    
+    // Loops outside the band keep their full trip count
+    std::vector<int> tileSizes(depth);
+    std::vector<std::vector<int>> candidates(depth);
+    for (int d = 0; d < depth; d++) {
+        int tripCount = nest.loops[d].tripCount;
+        tileSizes[d] = tripCount;
+        candidates[d] = {tripCount};
+        if (d < bandDepth) {
+            for (int size = tripCount > 1 ? 1 : tripCount; size < tripCount; size *= 2) {
+                candidates[d].push_back(size);
+            }
+        }
+    }
+    
+    // Search the tile sizes for the largest tile whose rows fit both in the
+    // working set of a core and, per array, in one subarray; ties go to the
+    // smaller footprint. If nothing fits, take the smallest tile.
+    std::vector<int> best = tileSizes;
+    long bestVolume = -1;
+    int bestFootprint = -1;
+    bool bestFits = false;
+    std::function<void(int, long)> search = [&](int level, long volume) {
+        if (level < bandDepth) {
+            for (int size : candidates[level]) {
+                tileSizes[level] = size;
+                search(level + 1, volume * size);
+            }
+            return;
+        }
+        
+        int maxArrayRows;
+        int footprint = tileFootprint(tileSizes, maxArrayRows);
+        bool fits = footprint <= target.workingSetRows && maxArrayRows <= target.rowsPerSubarray;
+        bool better;
+        if (fits != bestFits) {
+            better = fits;
+        } else if (fits) {
+            better = volume > bestVolume || (volume == bestVolume && footprint < bestFootprint);
+        } else {
+            better = bestVolume < 0 || footprint < bestFootprint;
+        }
+        if (better) {
+            best = tileSizes;
+            bestVolume = volume;
+            bestFootprint = footprint;
+            bestFits = fits;
+        }
+    };
+    search(0, 1);
+    
+    footprintRows = bestFootprint;
+    for (auto& loop : loops) {
+        if (loop.nestLevel < depth) {
+            loop.tileSize = best[loop.nestLevel];
+        }
+    }
+}
+
+int LoopTiler::getBandDepth() const {
+    return bandDepth;
+}
+
+int LoopTiler::getFootprintRows() const {
+    return footprintRows;
+}
+
+int LoopTiler::findPermutableBand() const {
+    int band = nest.loops.size();
+    for (const auto& dependence : dependences) {
+        for (int d = 0; d < static_cast<int>(dependence.directions.size()) && d < band; d++) {
+            if (dependence.directions[d] & Direction::GT) {
+                band = d;
+                break;
+            }
+        }
+    }
+    return band;
+}
+
+int LoopTiler::tileFootprint(const std::vector<int>& tileSizes, int& maxArrayRows) const {
+    int depth = nest.loops.size();
+    
+    // Accesses that differ only in their constant offsets (A[i][j], A[i-1][j])
+    // share rows, so they are merged into one region per linear part
+    struct Region {
+        int minRow, maxRow, minCol, maxCol;
+    };
+    std::map<std::tuple<int, std::vector<int>, std::vector<int>>, Region> regions;
+    for (const auto& access : nest.accesses) {
+        auto key = std::make_tuple(access.array, paddedCoeffs(access.row, depth), paddedCoeffs(access.col, depth));
+        auto it = regions.find(key);
+        if (it == regions.end()) {
+            regions[key] = {access.row.constant, access.row.constant, access.col.constant, access.col.constant};
+        } else {
+            auto& region = it->second;
+            region.minRow = std::min(region.minRow, access.row.constant);
+            region.maxRow = std::max(region.maxRow, access.row.constant);
+            region.minCol = std::min(region.minCol, access.col.constant);
+            region.maxCol = std::max(region.maxCol, access.col.constant);
+        }
+    }
+    
+    // The memory mapper's layout decides how many DRAM rows the region spans
+    std::vector<long> arrayRows(nest.arrays.size(), 0);
+    for (const auto& entry : regions) {
+        const auto& array = nest.arrays[std::get<0>(entry.first)];
+        const auto& region = entry.second;
+        long rows = subscriptSpan(std::get<1>(entry.first), region.maxRow - region.minRow, tileSizes,
+                                  nest.loops, array.rows);
+        long cols = subscriptSpan(std::get<2>(entry.first), region.maxCol - region.minCol, tileSizes,
+                                  nest.loops, array.cols);
+        arrayRows[std::get<0>(entry.first)] += memoryMapper.regionRows(std::get<0>(entry.first), rows, cols);
+    }
+    
+    long total = 0;
+    long largest = 0;
+    for (long rows : arrayRows) {
+        total += rows;
+        largest = std::max(largest, rows);
+    }
+    maxArrayRows = static_cast<int>(std::min<long>(largest, INT_MAX));
+    return static_cast<int>(std::min<long>(total, INT_MAX));
+}
\ No newline at end of file
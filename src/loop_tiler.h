@@ -0,0 +1,45 @@
+#ifndef LOOP_TILER_H
+#define LOOP_TILER_H
+
+#include "loop_nest.h"
+#include "loop_analyzer.h"
+#include "memory_mapper.h"
+#include "target_config.h"
+#include <vector>
+
+// Chooses rectangular tile sizes for the loop nest so that the DRAM rows one
+// tile touches fit in a core's working set, letting a core reuse activated
+// rows across the tile instead of re-opening them for every element
+class LoopTiler {
+public:
+    LoopTiler(const LoopNest& nest, const std::vector<Dependence>& dependences,
+              const TargetConfig& target, const MemoryMapper& memoryMapper);
+    
+    // Choose tile sizes and record them in the loops
+    void tile(std::vector<Loop>& loops);
+    
+    // Get the number of outer loops that may be tiled
+    int getBandDepth() const;
+    
+    // Get the number of rows one tile touches with the chosen sizes
+    int getFootprintRows() const;
+    
+private:
+    const LoopNest& nest;
+    const std::vector<Dependence>& dependences;
+    const TargetConfig& target;
+    const MemoryMapper& memoryMapper;
+    
+    int bandDepth = 0;
+    int footprintRows = 0;
+    
+    // Find the outermost run of loops that is fully permutable: no dependence
+    // runs backwards (>) in any of them, so rectangular tiles are legal
+    int findPermutableBand() const;
+    
+    // Rows touched by a tile of the given sizes; the largest footprint of a
+    // single array is returned through maxArrayRows
+    int tileFootprint(const std::vector<int>& tileSizes, int& maxArrayRows) const;
+};
+
+#endif // LOOP_TILER_H
\ No newline at end of file
@@ -2,31 +2,270 @@
 #include "loop_analyzer.h"
 #include "memory_mapper.h"
 #include "instruction_generator.h"
+#include "loop_tiler.h"
+#include "loop_interchange.h"
+#include "target_config.h"
+#include "peephole_optimizer.h"
+#include "list_scheduler.h"
+#include "sync_placer.h"
+#include "operand_forwarder.h"
+#include "loop_compressor.h"
+#include "instruction_sink.h"
+#include "constant_matrix.h"
+#include "binary_program.h"
+#include "paper_encoder.h"
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <memory>
 
 void printInstructions(const std::vector<PimInstruction>& instructions, std::ostream& out) {
-    out << "# PIM ISA Instructions for Matrix Multiplication" << std::endl;
-    out << "# Format: [Binary] [Opcode] core=[Core ID] row=[Row Address] flags=[Flags]" << std::endl;
-    out << std::endl;
-    
-    for (size_t i = 0; i < instructions.size(); i++) {
-        const auto& inst = instructions[i];
-        out << std::setw(8) << std::setfill('0') << std::hex << inst.toBinary() << " ";
-        out << std::setw(0) << std::setfill(' ') << std::dec << inst.toString() << std::endl;
+    printInstructionHeader(out);
+    for (const auto& inst : instructions) {
+        printInstruction(inst, out);
+    }
+}
+
+// Write a program to a file, as a binary program for the target or as a
+// text listing, lowered to the paper's format by the encoder if one is given
+bool writeProgram(const std::vector<PimInstruction>& program, const std::string& filename, bool binary,
+                  PaperEncoder* paperEncoder, const TargetConfig& target) {
+    std::vector<PaperISAInstruction> paperProgram;
+    bool paper = paperEncoder != nullptr;
+    if (paper && !paperEncoder->encode(program, paperProgram)) {
+        return false;
+    }
+    std::ofstream out(filename, binary ? std::ios::out | std::ios::binary : std::ios::out);
+    if (!out) {
+        std::cerr << "Failed to open output file: " << filename << std::endl;
+        return false;
     }
+    if (binary) {
+        BinaryProgramHeader header;
+        header.setTarget(target);
+        if (paper) {
+            header.encoding = BinaryProgramHeader::Encoding::PAPER;
+            header.wordBytes = 3;
+        } else {
+            header.wordBytes = BinaryProgramHeader::wordBytesFor(program);
+        }
+        BinarySink binarySink(out, header);
+        if (paper) {
+            for (const auto& inst : paperProgram) {
+                binarySink.emitWord(inst.toBinary());
+            }
+        } else {
+            for (const auto& inst : program) {
+                binarySink.emit(inst);
+            }
+        }
+        binarySink.finish();
+    } else if (paper) {
+        PaperEncoder::print(paperProgram, out);
+    } else {
+        printInstructions(program, out);
+    }
+    if (!out) {
+        std::cerr << "Failed to write output file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void printGenerationStats(const InstructionGenerator& instructionGenerator, const MemoryMapper& memoryMapper,
+                          const TargetConfig& target, const std::vector<Loop>& loops) {
+    const auto& coreLoads = instructionGenerator.getCoreLoads();
+    long busiestLoad = *std::max_element(coreLoads.begin(), coreLoads.end());
+    long totalLoad = std::accumulate(coreLoads.begin(), coreLoads.end(), 0L);
+    std::string distributed;
+    for (int level : instructionGenerator.getDistributedLoops()) {
+        distributed += (distributed.empty() ? "" : " ") + loops[level].inductionVar;
+    }
+    std::cout << "Distribution: " << target.distribution.toString() << " over " << target.cores
+              << " cores, estimated cycles per core max " << busiestLoad << ", mean "
+              << totalLoad / static_cast<long>(coreLoads.size()) << std::endl;
+    if (distributed.empty()) {
+        std::cout << "No loop can run in parallel: the kernel is serialized on core 0" << std::endl;
+    } else {
+        std::cout << "Distributed loops: " << distributed << std::endl;
+    }
+    std::cout << "Temporaries: peak " << memoryMapper.getPeakTemps() << " live, "
+              << memoryMapper.getPeakTempRows() << " rows" << std::endl;
+    std::cout << "LUT programming: " << instructionGenerator.getLutPrograms() << " PROGRAM_LUT, "
+              << instructionGenerator.getLutProgramsSkipped() << " left out" << std::endl;
+    if (instructionGenerator.getConstantLoadsSkipped() > 0) {
+        std::cout << "Constant operands: " << instructionGenerator.getConstantLoadsSkipped() << " loads left out, "
+                  << instructionGenerator.getZeroProductsSkipped() << " multiplies by zero dropped" << std::endl;
+    }
+}
+
+// Instructions name rows with 16 bits, so a program needing more rows would
+// alias them
+bool checkRowRange(const MemoryMapper& memoryMapper) {
+    if (memoryMapper.getTotalRowsNeeded() > 1 << 16) {
+        std::cerr << "The program needs " << memoryMapper.getTotalRowsNeeded()
+                  << " rows, more than 16-bit row addresses reach" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <input_file> <output_file>" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --target <file>  Target description (rows_per_subarray, row_buffer_bytes, working_set_rows)" << std::endl;
+    std::cerr << "  --no-tiling      Walk the iteration space without tiling" << std::endl;
+    std::cerr << "  --no-interchange Keep the loops in source order" << std::endl;
+    std::cerr << "  --no-lut-grouping  Lower each point's body in order instead of a tile's multiplies first" << std::endl;
+    std::cerr << "  --no-mac         Keep the multiply and the add of a sum of products apart" << std::endl;
+    std::cerr << "  --no-peephole    Keep the generated instructions as they are" << std::endl;
+    std::cerr << "  --no-forwarding  Load every operand from DRAM instead of forwarding it between cores" << std::endl;
+    std::cerr << "  --no-schedule    Keep the instructions in generation order instead of interleaving the cores" << std::endl;
+    std::cerr << "  --per-core-output  Also write each core's instructions to <output_file>.core<n>" << std::endl;
+    std::cerr << "  --compress       Write runs of instructions with constant address strides as REPEAT loops;" << std::endl;
+    std::cerr << "                   the instructions stay in generation order, as interleaving the cores" << std::endl;
+    std::cerr << "                   breaks the runs" << std::endl;
+    std::cerr << "  --binary         Write a binary program (target header, then packed instruction words)" << std::endl;
+    std::cerr << "                   instead of a text listing" << std::endl;
+    std::cerr << "  --disassembly <file>  Also write the text listing to <file>" << std::endl;
+    std::cerr << "  --paper-format   Write the instructions in the 24-bit format of the paper, as text or with" << std::endl;
+    std::cerr << "                   --binary as packed 24-bit words" << std::endl;
+    std::cerr << "  --stream         Write instructions as they are generated, in bounded memory; skips the" << std::endl;
+    std::cerr << "                   peephole pass, forwarding, scheduling, compression and per-core output," << std::endl;
+    std::cerr << "                   which need the whole program, and generates on one thread" << std::endl;
+    std::cerr << "  --jobs <n>       Generate the instructions of different cores on up to n threads" << std::endl;
+    std::cerr << "                   (default: the number of hardware threads)" << std::endl;
+    std::cerr << "  --split-reduction <n>  Split the reduction loop into n chunks on different cores" << std::endl;
+    std::cerr << "  --layout <matrix>=<layout>  Lay matrix A, B or C out as row, column, blocked[:edge] or morton" << std::endl;
+    std::cerr << "  --constant <matrix>=<file>  Take matrix A or B as known, with its values in a binary file of" << std::endl;
+    std::cerr << "                   row-major little-endian elements, and multiply by them with per-value LUTs" << std::endl;
+    std::cerr << "  --cores <n>      Spread the parallel iterations over n cores (at most " << TargetConfig::maxCores << ")" << std::endl;
+    std::cerr << "  --distribution <d>  Spread them block, cyclic, block-cyclic[:edge] or balanced" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file>" << std::endl;
+    TargetConfig target;
+    bool enableTiling = true;
+    bool enableInterchange = true;
+    bool groupMultiplies = true;
+    bool enablePeephole = true;
+    bool enableMac = true;
+    bool enableForwarding = true;
+    bool enableSchedule = true;
+    bool perCoreOutput = false;
+    bool compressOutput = false;
+    bool streamOutput = false;
+    bool binaryOutput = false;
+    bool paperFormat = false;
+    std::string disassemblyFile;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    int reductionWays = 1;
+    std::vector<std::string> layoutOptions;
+    std::string constantOption;
+    int cores = 0;
+    std::string distribution;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--target" && i + 1 < argc) {
+            if (!target.loadFromFile(argv[++i])) {
+                return 1;
+            }
+        } else if (arg == "--no-tiling") {
+            enableTiling = false;
+        } else if (arg == "--no-interchange") {
+            enableInterchange = false;
+        } else if (arg == "--no-lut-grouping") {
+            groupMultiplies = false;
+        } else if (arg == "--no-mac") {
+            enableMac = false;
+        } else if (arg == "--no-peephole") {
+            enablePeephole = false;
+        } else if (arg == "--no-forwarding") {
+            enableForwarding = false;
+        } else if (arg == "--no-schedule") {
+            enableSchedule = false;
+        } else if (arg == "--per-core-output") {
+            perCoreOutput = true;
+        } else if (arg == "--compress") {
+            compressOutput = true;
+        } else if (arg == "--stream") {
+            streamOutput = true;
+        } else if (arg == "--binary") {
+            binaryOutput = true;
+        } else if (arg == "--paper-format") {
+            paperFormat = true;
+        } else if (arg == "--disassembly" && i + 1 < argc) {
+            disassemblyFile = argv[++i];
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::atoi(argv[++i]);
+            if (jobs <= 0) {
+                std::cerr << "Invalid job count: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--split-reduction" && i + 1 < argc) {
+            reductionWays = std::atoi(argv[++i]);
+            if (reductionWays < 1) {
+                std::cerr << "Invalid reduction split: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--layout" && i + 1 < argc) {
+            layoutOptions.push_back(argv[++i]);
+        } else if (arg == "--constant" && i + 1 < argc) {
+            constantOption = argv[++i];
+        } else if (arg == "--cores" && i + 1 < argc) {
+            cores = std::atoi(argv[++i]);
+            if (cores <= 0 || cores > TargetConfig::maxCores) {
+                std::cerr << "Invalid core count: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--distribution" && i + 1 < argc) {
+            distribution = argv[++i];
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    
+    // Layouts on the command line override the target description
+    for (const auto& option : layoutOptions) {
+        size_t equals = option.find('=');
+        if (equals == std::string::npos || !target.setLayout(option.substr(0, equals), option.substr(equals + 1))) {
+            std::cerr << "Invalid layout: " << option << std::endl;
+            return 1;
+        }
+    }
+    if (cores > 0) {
+        target.cores = cores;
+    }
+    if (!distribution.empty() && !target.distribution.parse(distribution)) {
+        std::cerr << "Invalid distribution: " << distribution << std::endl;
+        return 1;
+    }
+    if (positional.size() != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (streamOutput && !disassemblyFile.empty()) {
+        std::cerr << "A disassembly cannot be written while streaming" << std::endl;
+        return 1;
+    }
+    if (paperFormat && (streamOutput || compressOutput)) {
+        std::cerr << "The paper's format cannot be streamed and has no loops to compress into" << std::endl;
         return 1;
     }
     
-    std::string inputFile = argv[1];
-    std::string outputFile = argv[2];
+    std::string inputFile = positional[0];
+    std::string outputFile = positional[1];
     
     // Step 1: Parse the input file
     Parser parser;
@@ -35,22 +274,94 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    // Get the three-address code
-    const auto& threeAddressCode = parser.getThreeAddressCode();
-    
-    // Print the three-address code
-    std::cout << "Three-Address Code:" << std::endl;
-    for (const auto& inst : threeAddressCode) {
-        std::cout << inst.toString() << std::endl;
+    std::cout << "Kernel: " << parser.getKernelName() << std::endl;
+    for (const auto& array : parser.getLoopNest().arrays) {
+        std::cout << "Array " << array.name << ": " << array.rows << "x" << array.cols << std::endl;
     }
     std::cout << std::endl;
     
+    // Get the affine loop nest
+    const auto& loopNest = parser.getLoopNest();
+    
+    // Print the loop nest with its three-address body
+    std::cout << "Three-Address Code:" << std::endl;
+    std::cout << loopNest.toString() << std::endl;
+    
     // Step 2: Analyze loops for parallelization
-    LoopAnalyzer loopAnalyzer(threeAddressCode);
+    LoopAnalyzer loopAnalyzer(loopNest);
     loopAnalyzer.analyze();
     
     // Get the identified loops
-    const auto& loops = loopAnalyzer.getLoops();
+    std::vector<Loop> loops = loopAnalyzer.getLoops();
+    
+    // Step 3: Set up memory mapping, placing every array with its parsed
+    // shape; the layouts of A, B and C apply to the arrays of those names
+    int elementSize = 1;
+    for (const auto& array : loopNest.arrays) {
+        elementSize = std::max(elementSize, array.elementSize);
+    }
+    // The paper's format cannot name a column, so it keeps an element per
+    // row, as if the row buffer were one element wide
+    if (paperFormat) {
+        target.rowBufferBytes = elementSize;
+    }
+    MemoryMapper memoryMapper(loopNest.arrays, target.elementsPerRow(elementSize), target.rowsPerSubarray);
+    for (int matrix = 0; matrix < 3; matrix++) {
+        int array = memoryMapper.matrixIndex(std::string(1, static_cast<char>('A' + matrix)));
+        if (array >= 0) {
+            memoryMapper.setLayout(array, target.layouts[matrix]);
+        }
+    }
+    
+    // Matrices that reach past the 16-bit row addresses are rejected before
+    // any of their rows is handed out
+    if (!checkRowRange(memoryMapper)) {
+        return 1;
+    }
+    
+    // Read the values of a matrix known at compile time
+    ConstantMatrix constantValues;
+    int constantMatrix = -1;
+    if (!constantOption.empty()) {
+        size_t equals = constantOption.find('=');
+        std::string matrixName = constantOption.substr(0, equals);
+        const ArrayShape* shape = nullptr;
+        for (const auto& array : loopNest.arrays) {
+            if (array.name == matrixName) {
+                shape = &array;
+            }
+        }
+        constantMatrix = memoryMapper.matrixIndex(matrixName);
+        if (equals == std::string::npos || shape == nullptr || constantMatrix < 0) {
+            std::cerr << "Invalid constant matrix: " << constantOption << std::endl;
+            return 1;
+        }
+        if (!constantValues.loadFromFile(constantOption.substr(equals + 1), shape->rows, shape->cols, shape->elementSize)) {
+            return 1;
+        }
+        std::cout << "Constant matrix " << matrixName << ": " << constantValues.distinctValues()
+                  << " distinct values" << std::endl;
+    }
+    
+    // Step 4: Order the loops for row-buffer locality, then tile the nest for
+    // the target
+    LoopInterchange loopInterchange(loopNest, loops, loopAnalyzer.getDependences(), memoryMapper, target);
+    if (constantMatrix >= 0) {
+        loopInterchange.setConstantMatrix(constantMatrix);
+    }
+    std::vector<int> loopOrder;
+    for (int level = 0; level < loops.size(); level++) {
+        loopOrder.push_back(level);
+    }
+    double originalCost = loopInterchange.estimateActivations(loopOrder);
+    if (enableInterchange) {
+        loopOrder = loopInterchange.chooseOrder();
+    }
+    
+    LoopTiler loopTiler(loopNest, loopAnalyzer.getDependences(), target, memoryMapper);
+    if (enableTiling) {
+        loopTiler.tile(loops);
+    }
     
     // Print the loops
     std::cout << "Identified Loops:" << std::endl;
@@ -58,40 +369,234 @@ int main(int argc, char* argv[]) {
         std::cout << "Loop " << loop.inductionVar << ": ";
         std::cout << "Nest Level = " << loop.nestLevel << ", ";
         std::cout << "Range = [" << loop.lowerBound << ", " << loop.upperBound << "], ";
-        std::cout << "Parallelizable = " << (loop.isParallelizable ? "Yes" : "No") << std::endl;
+        std::cout << "Parallelizable = " << (loop.isParallelizable ? "Yes" : "No");
+        std::cout << (loop.isReduction ? " (reduction)" : "");
+        std::cout << ", Tile = " << loop.tileSize << std::endl;
     }
     std::cout << std::endl;
     
-    // Step 3: Set up memory mapping
-    int rows1, cols1, rows2, cols2;
-    parser.getMatrixDimensions(rows1, cols1, rows2, cols2);
+    // Print the array dependences and reductions
+    static const char* dependenceKinds[] = {"flow", "anti", "output"};
+    std::cout << "Dependences:" << std::endl;
+    for (const auto& dependence : loopAnalyzer.getDependences()) {
+        std::cout << "  " << dependenceKinds[static_cast<int>(dependence.kind)] << " ["
+                  << loopNest.toString(loopNest.body[dependence.source]) << "] -> ["
+                  << loopNest.toString(loopNest.body[dependence.sink]) << "] direction "
+                  << dependence.directionString() << " distance " << dependence.distanceString()
+                  << (dependence.isReduction ? " (reduction)" : "") << std::endl;
+    }
+    for (const auto& reduction : loopAnalyzer.getReductions()) {
+        std::cout << "Reduction: " << loopNest.operandToString(loopNest.body[reduction.store].dest)
+                  << (reduction.op == ThreeAddressInst::OpType::ADD ? " += " : " *= ") << "over";
+        for (int level : reduction.loops) {
+            std::cout << " " << loopNest.loops[level].inductionVar;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "Layouts: A " << target.layouts[0].toString() << ", B " << target.layouts[1].toString()
+              << ", C " << target.layouts[2].toString() << std::endl;
+    std::cout << "Loop order:";
+    for (int level : loopOrder) {
+        std::cout << " " << loops[level].inductionVar;
+    }
+    std::cout << " (estimated row activations " << static_cast<long>(loopInterchange.estimateActivations(loopOrder))
+              << ", original order " << static_cast<long>(originalCost) << ")" << std::endl;
+    if (enableTiling) {
+        std::cout << "Tiling: " << loopTiler.getBandDepth() << " permutable loops, "
+                  << loopTiler.getFootprintRows() << " rows per tile (working set "
+                  << target.workingSetRows << ", subarray " << target.rowsPerSubarray << " rows)" << std::endl;
+    }
+    auto dependencyGraph = loopAnalyzer.getDependencyGraph();
+    std::cout << "Dependency graph: " << dependencyGraph.size() << " instructions, "
+              << dependencyGraph.edgeCount() << " edges" << std::endl;
+    std::cout << std::endl;
     
-    // For the example, we'll use 3x3 matrices
-    if (rows1 == 0) rows1 = 3;
-    if (cols1 == 0) cols1 = 3;
-    if (rows2 == 0) rows2 = 3;
-    if (cols2 == 0) cols2 = 3;
+    // Step 5: Generate PIM ISA instructions
+    InstructionGenerator instructionGenerator(loopNest, loops, memoryMapper);
+    instructionGenerator.setLoopOrder(loopOrder);
+    instructionGenerator.setTarget(target);
+    instructionGenerator.setJobs(streamOutput ? 1 : jobs);
+    instructionGenerator.setGroupMultiplies(groupMultiplies);
+    if (constantMatrix >= 0 && !instructionGenerator.setConstantMatrix(constantMatrix, constantValues)) {
+        return 1;
+    }
+    if (reductionWays > 1) {
+        if (loopAnalyzer.getReductions().empty()) {
+            std::cerr << "No reduction to split across cores" << std::endl;
+        } else if (instructionGenerator.splitReduction(loopAnalyzer.getReductions()[0], reductionWays)) {
+            std::cout << "Reduction split into " << reductionWays << " chunks combined by a tree" << std::endl;
+        }
+    }
+    // The paper's EXE points at its operation, so it cannot name the core
+    // whose accumulator row a multiply-accumulate updates
+    if (enableMac && paperFormat) {
+        std::cout << "Multiply-accumulates are not fused: the paper's format cannot address their rows" << std::endl;
+    } else if (enableMac && !loopAnalyzer.getReductions().empty() &&
+        instructionGenerator.fuseMultiplyAccumulate(loopAnalyzer.getReductions()[0])) {
+        std::cout << "Reduction fused into multiply-accumulates" << std::endl;
+    }
     
-    MemoryMapper memoryMapper(rows1, cols1, rows2, cols2);
+    // Streamed instructions go straight to the output file, with the SYNC
+    // pairs placed on the way; a binary program takes full words, as the
+    // instructions to come are not known
+    if (streamOutput) {
+        std::ofstream outFile(outputFile, binaryOutput ? std::ios::out | std::ios::binary : std::ios::out);
+        if (!outFile) {
+            std::cerr << "Failed to open output file: " << outputFile << std::endl;
+            return 1;
+        }
+        std::unique_ptr<BinarySink> binarySink;
+        std::unique_ptr<StreamSink> streamSink;
+        InstructionSink* sink;
+        if (binaryOutput) {
+            BinaryProgramHeader header;
+            header.setTarget(target);
+            binarySink = std::make_unique<BinarySink>(outFile, header);
+            sink = binarySink.get();
+        } else {
+            streamSink = std::make_unique<StreamSink>(outFile);
+            sink = streamSink.get();
+        }
+        SyncPlacer syncPlacer(sink);
+        instructionGenerator.generateInstructions(syncPlacer);
+        if (!syncPlacer.finish()) {
+            std::cerr << "Failed to write output file: " << outputFile << std::endl;
+            return 1;
+        }
+        long count = binaryOutput ? binarySink->getCount() : streamSink->getCount();
+        std::cout << "Generated " << count - 2 * syncPlacer.getSyncPairs()
+                  << " PIM ISA instructions." << std::endl;
+        printGenerationStats(instructionGenerator, memoryMapper, target, loops);
+        if (count == 0) {
+            std::cerr << "The loop nest produced no instructions" << std::endl;
+            return 1;
+        }
+        if (!checkRowRange(memoryMapper)) {
+            return 1;
+        }
+        std::cout << "Synchronization: " << syncPlacer.getSyncPairs() << " SYNC pairs between cores" << std::endl;
+        std::cout << "Instructions streamed to " << outputFile << std::endl;
+        return 0;
+    }
     
-    // Step 4: Generate PIM ISA instructions
-    InstructionGenerator instructionGenerator(threeAddressCode, loops, memoryMapper);
     auto instructions = instructionGenerator.generateInstructions();
+    std::cout << "Generated " << instructions.size() << " PIM ISA instructions";
+    if (instructionGenerator.getWorkerCount() > 1) {
+        std::cout << " on " << instructionGenerator.getWorkerCount() << " threads";
+    }
+    std::cout << "." << std::endl;
+    printGenerationStats(instructionGenerator, memoryMapper, target, loops);
+    if (instructions.empty()) {
+        std::cerr << "The loop nest produced no instructions" << std::endl;
+        return 1;
+    }
+    if (!checkRowRange(memoryMapper)) {
+        return 1;
+    }
     
-    // Print the instructions
-    std::cout << "Generated " << instructions.size() << " PIM ISA instructions." << std::endl;
+    // Step 6: Clean up copies, reloads and dead stores
+    if (enablePeephole) {
+        size_t generated = instructions.size();
+        PeepholeOptimizer peepholeOptimizer(memoryMapper);
+        peepholeOptimizer.optimize(instructions);
+        std::cout << "Peephole: " << generated << " -> " << instructions.size() << " instructions ("
+                  << peepholeOptimizer.getCopiesPropagated() << " loads redirected, "
+                  << peepholeOptimizer.getRedundantRemoved() << " redundant, "
+                  << peepholeOptimizer.getDeadRemoved() << " removed with dead stores)" << std::endl;
+    }
     
-    // Write the instructions to the output file
-    std::ofstream outFile(outputFile);
-    if (!outFile) {
-        std::cerr << "Failed to open output file: " << outputFile << std::endl;
-        return 1;
+    // Step 7: Forward operands that other cores of a wave load as well
+    if (enableForwarding) {
+        auto countLoads = [&]() {
+            return std::count_if(instructions.begin(), instructions.end(),
+                                 [](const PimInstruction& inst) { return inst.opcode == Opcode::LOAD; });
+        };
+        long loads = countLoads();
+        OperandForwarder operandForwarder;
+        operandForwarder.forward(instructions);
+        std::cout << "Forwarding: " << operandForwarder.getForwarded() << " operands taken from "
+                  << operandForwarder.getBroadcasts() << " broadcasts (DRAM loads " << loads << " -> "
+                  << countLoads() << ")" << std::endl;
     }
     
-    printInstructions(instructions, outFile);
-    outFile.close();
+    // Step 8: Synchronize cores that share a location
+    SyncPlacer syncPlacer;
+    syncPlacer.place(instructions);
+    std::cout << "Synchronization: " << syncPlacer.getSyncPairs() << " SYNC pairs between cores" << std::endl;
     
+    // Step 9: Interleave the cores' instruction streams. The interleaving
+    // breaks up the strided runs of each core, so compressed output keeps
+    // the generation order.
+    if (enableSchedule && compressOutput) {
+        std::cout << "Schedule: skipped, the cores' runs are compressed in generation order" << std::endl;
+    } else if (enableSchedule) {
+        ListScheduler listScheduler(target);
+        instructions = listScheduler.schedule(instructions);
+        std::cout << "Schedule: " << listScheduler.getCycles() << " cycles (serial "
+                  << listScheduler.getSerialCycles() << "), bus busy "
+                  << std::fixed << std::setprecision(1) << listScheduler.getBusUtilization() * 100 << "%"
+                  << std::defaultfloat << std::endl;
+    }
+    
+    // Step 10: Fold runs with constant address strides into loops, and check
+    // that they expand back to the same instructions
+    LoopCompressor loopCompressor;
+    auto encode = [&](const std::vector<PimInstruction>& flat, std::vector<PimInstruction>& program) {
+        if (!compressOutput) {
+            program = flat;
+            return true;
+        }
+        program = loopCompressor.compress(flat);
+        std::vector<PimInstruction> expanded;
+        if (!LoopCompressor::expand(program, expanded) || expanded.size() != flat.size() ||
+            !std::equal(expanded.begin(), expanded.end(), flat.begin(), [](const auto& a, const auto& b) {
+                return a.toBinary() == b.toBinary();
+            })) {
+            std::cerr << "Compressed instructions do not expand to the original ones" << std::endl;
+            return false;
+        }
+        return true;
+    };
+    std::vector<PimInstruction> program;
+    if (!encode(instructions, program)) {
+        return 1;
+    }
+    if (compressOutput) {
+        std::cout << "Compression: " << instructions.size() << " -> " << program.size() << " instructions ("
+                  << loopCompressor.getLoops() << " loops, expansion matches)" << std::endl;
+    }
+    
+    // Write the instructions to the output file, and their listing to the
+    // disassembly
+    PaperEncoder paperEncoder;
+    if (!writeProgram(program, outputFile, binaryOutput, paperFormat ? &paperEncoder : nullptr, target)) {
+        return 1;
+    }
+    if (paperFormat) {
+        std::cout << "Paper format: " << paperEncoder.getBaseLoads() << " BASE instructions for segments of "
+                  << PaperISAInstruction::segmentRows << " rows" << std::endl;
+    }
     std::cout << "Instructions written to " << outputFile << std::endl;
+    if (!disassemblyFile.empty()) {
+        if (!writeProgram(program, disassemblyFile, false, nullptr, target)) {
+            return 1;
+        }
+        std::cout << "Disassembly written to " << disassemblyFile << std::endl;
+    }
+    
+    if (perCoreOutput) {
+        auto streams = ListScheduler::splitByCore(instructions);
+        for (size_t core = 0; core < streams.size(); core++) {
+            if (streams[core].empty()) {
+                continue;
+            }
+            std::string coreFile = outputFile + ".core" + std::to_string(core);
+            if (!encode(streams[core], program) || !writeProgram(program, coreFile, binaryOutput, paperFormat ? &paperEncoder : nullptr, target)) {
+                return 1;
+            }
+        }
+        std::cout << "Per-core instructions written to " << outputFile << ".core<n>" << std::endl;
+    }
     
     return 0;
 }
\ No newline at end of file
@@ -1,86 +1,275 @@
 #include "memory_mapper.h"
 #include <iostream>
-#include <regex>
 #include <cstdint>
+#include <algorithm>
+#include <cmath>
 
-MemoryMapper::MemoryMapper(int rows1, int cols1, int rows2, int cols2)
-    : matrixRows1(rows1), matrixCols1(cols1), matrixRows2(rows2), matrixCols2(cols2) {
-    
-    // Set base row addresses for matrices
-    matrixABaseRow = 0;
-    matrixBBaseRow = matrixRows1 * matrixCols1;
-    matrixCBaseRow = matrixBBaseRow + matrixRows2 * matrixCols2;
-    
-    initializeMapping();
+MemoryMapper::MemoryMapper(const std::vector<ArrayShape>& arrays, int elementsPerRow, int rowsPerSubarray)
+    : elementsPerRow(elementsPerRow > 0 ? elementsPerRow : 1),
+      rowsPerSubarray(rowsPerSubarray > 0 ? rowsPerSubarray : 1), matrices(arrays.size()), tempPools(1) {
+    for (size_t matrix = 0; matrix < arrays.size(); matrix++) {
+        matrices[matrix].name = arrays[matrix].name;
+        matrices[matrix].rows = arrays[matrix].rows;
+        matrices[matrix].cols = arrays[matrix].cols;
+    }
+    placeMatrices();
+}
+
+namespace {
+
+// Interleave the bits of a value with zeros: abcd -> 0a0b0c0d
+uint32_t spreadBits(uint32_t value) {
+    value &= 0xffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
+
+// Largest power of two not above value
+int floorPowerOfTwo(int value) {
+    int power = 1;
+    while (power * 2 <= value) {
+        power *= 2;
+    }
+    return power;
+}
+
+// Smallest power of two not below value
+int ceilPowerOfTwo(int value) {
+    int power = 1;
+    while (power < value) {
+        power *= 2;
+    }
+    return power;
+}
+
+} // namespace
+
+int MemoryMapper::rowsPerLine(int length) const {
+    return (length + elementsPerRow - 1) / elementsPerRow;
 }
 
-void MemoryMapper::initializeMapping() {
-    // Map matrix A elements
-    for (int i = 0; i < matrixRows1; i++) {
-        for (int j = 0; j < matrixCols1; j++) {
-            std::string varName = "A_" + std::to_string(i) + "_" + std::to_string(j);
-            uint16_t rowAddr = matrixABaseRow + i * matrixCols1 + j;
-            variableToRowMap[varName] = rowAddr;
+void MemoryMapper::placeMatrices() {
+    // Each matrix and the temporaries start a new subarray so that their rows
+    // do not compete for the same row buffer
+    int nextRow = 0;
+    for (auto& matrix : matrices) {
+        switch (matrix.layout.kind) {
+            case DataLayout::Kind::ROW_MAJOR:
+                matrix.lineStride = rowsPerLine(matrix.cols);
+                matrix.lineCount = matrix.rows;
+                break;
+            case DataLayout::Kind::COLUMN_MAJOR:
+                matrix.lineStride = rowsPerLine(matrix.rows);
+                matrix.lineCount = matrix.cols;
+                break;
+            case DataLayout::Kind::BLOCKED: {
+                // By default the largest power-of-two square that fills a row
+                int edge = matrix.layout.blockSize;
+                if (edge <= 0) {
+                    edge = std::min(floorPowerOfTwo(static_cast<int>(std::sqrt(elementsPerRow))),
+                                    ceilPowerOfTwo(std::max(matrix.rows, matrix.cols)));
+                }
+                matrix.blockRows = edge;
+                matrix.blockCols = edge;
+                matrix.lineStride = rowsPerLine(edge * edge);
+                matrix.lineCount = ((matrix.rows + edge - 1) / edge) * ((matrix.cols + edge - 1) / edge);
+                break;
+            }
+            case DataLayout::Kind::MORTON: {
+                // The curve covers a power-of-two square; a row holds the
+                // aligned block of the largest power-of-two number of elements
+                // that fits, columns taking the extra bit when it is odd
+                int edge = ceilPowerOfTwo(std::max(matrix.rows, matrix.cols));
+                int slots = std::min(floorPowerOfTwo(elementsPerRow), edge * edge);
+                int bits = 0;
+                while ((1 << bits) < slots) {
+                    bits++;
+                }
+                matrix.blockCols = 1 << ((bits + 1) / 2);
+                matrix.blockRows = 1 << (bits / 2);
+                matrix.lineStride = 1;
+                matrix.lineCount = edge * edge / slots;
+                break;
+            }
         }
+        matrix.baseRow = alignToSubarray(nextRow);
+        nextRow = matrix.baseRow + matrix.lineCount * matrix.lineStride;
     }
-    
-    // Map matrix B elements
-    for (int i = 0; i < matrixRows2; i++) {
-        for (int j = 0; j < matrixCols2; j++) {
-            std::string varName = "B_" + std::to_string(i) + "_" + std::to_string(j);
-            uint16_t rowAddr = matrixBBaseRow + i * matrixCols2 + j;
-            variableToRowMap[varName] = rowAddr;
+    tempBaseRow = alignToSubarray(nextRow);
+}
+
+int MemoryMapper::alignToSubarray(int row) const {
+    return (row + rowsPerSubarray - 1) / rowsPerSubarray * rowsPerSubarray;
+}
+
+int MemoryMapper::matrixIndex(const std::string& matrixName) const {
+    for (size_t matrix = 0; matrix < matrices.size(); matrix++) {
+        if (matrices[matrix].name == matrixName) {
+            return matrix;
         }
     }
+    return -1;
+}
+
+void MemoryMapper::setLayout(int matrix, const DataLayout& layout) {
+    matrices[matrix].layout = layout;
+    placeMatrices();
+}
+
+const DataLayout& MemoryMapper::getLayout(int matrix) const {
+    return matrices[matrix].layout;
+}
+
+MemoryLocation MemoryMapper::getMatrixElementLocation(int matrix, int row, int col) const {
+    MemoryLocation location;
     
-    // Map matrix C elements
-    for (int i = 0; i < matrixRows1; i++) {
-        for (int j = 0; j < matrixCols2; j++) {
-            std::string varName = "C_" + std::to_string(i) + "_" + std::to_string(j);
-            uint16_t rowAddr = matrixCBaseRow + i * matrixCols2 + j;
-            variableToRowMap[varName] = rowAddr;
+    // Find the line holding the element and its offset within the line
+    const auto& placement = matrices[matrix];
+    int line, offset;
+    switch (placement.layout.kind) {
+        case DataLayout::Kind::ROW_MAJOR:
+            line = row;
+            offset = col;
+            break;
+        case DataLayout::Kind::COLUMN_MAJOR:
+            line = col;
+            offset = row;
+            break;
+        case DataLayout::Kind::BLOCKED: {
+            int blocksPerRow = (placement.cols + placement.blockCols - 1) / placement.blockCols;
+            line = (row / placement.blockRows) * blocksPerRow + col / placement.blockCols;
+            offset = (row % placement.blockRows) * placement.blockCols + col % placement.blockCols;
+            break;
+        }
+        case DataLayout::Kind::MORTON: {
+            int slots = placement.blockRows * placement.blockCols;
+            uint32_t index = (spreadBits(row) << 1) | spreadBits(col);
+            line = index / slots;
+            offset = index % slots;
+            break;
         }
+        default:
+            line = 0;
+            offset = 0;
+            break;
     }
+    location.row = placement.baseRow + line * placement.lineStride + offset / elementsPerRow;
+    location.col = offset % elementsPerRow;
+    return location;
 }
 
-uint16_t MemoryMapper::mapVariableToRow(const std::string& varName) {
-    // Check if the variable is already mapped
-    if (variableToRowMap.find(varName) != variableToRowMap.end()) {
-        return variableToRowMap[varName];
+long MemoryMapper::regionRows(int matrix, long rows, long cols) const {
+    const auto& placement = matrices[matrix];
+    switch (placement.layout.kind) {
+        case DataLayout::Kind::ROW_MAJOR:
+            return rows * rowsPerLine(cols);
+        case DataLayout::Kind::COLUMN_MAJOR:
+            return cols * rowsPerLine(rows);
+        default: {
+            long blocks = ((rows + placement.blockRows - 1) / placement.blockRows) *
+                          ((cols + placement.blockCols - 1) / placement.blockCols);
+            return blocks * placement.lineStride;
+        }
+    }
+}
+
+MemoryLocation MemoryMapper::mapConstant(int value) {
+    auto it = constantLocations.find(value);
+    if (it != constantLocations.end()) {
+        return it->second;
     }
     
-    // Check if it's a matrix element using regex
-    std::regex matrixPattern("([A-C])_([0-9]+)_([0-9]+)");
-    std::smatch matches;
-    
-    if (std::regex_match(varName, matches, matrixPattern)) {
-        std::string matrixName = matches[1].str();
-        int row = std::stoi(matches[2].str());
-        int col = std::stoi(matches[3].str());
-        
-        return getMatrixElementRow(matrixName, row, col);
+    // Constants keep a temporary slot for good
+    MemoryLocation location = allocateTemp();
+    constantLocations[value] = location;
+    return location;
+}
+
+MemoryLocation MemoryMapper::constantLocation(int value) const {
+    auto it = constantLocations.find(value);
+    if (it != constantLocations.end()) {
+        return it->second;
+    }
+    std::cerr << "Constant " << value << " was not mapped" << std::endl;
+    return MemoryLocation{0, 0};
+}
+
+void MemoryMapper::setCores(int cores) {
+    this->cores = std::max(1, cores);
+    tempPools.assign(this->cores, TempPool());
+    constantLocations.clear();
+}
+
+MemoryLocation MemoryMapper::allocateTemp(int core) {
+    core %= cores;
+    TempPool& pool = tempPools[core];
+    int slot;
+    if (!pool.freeSlots.empty()) {
+        slot = pool.freeSlots.top();
+        pool.freeSlots.pop();
+    } else {
+        slot = pool.slotsTaken++ * cores + core;
     }
     
-    // For temporary variables, allocate new rows after the matrices
-    uint16_t newRow = matrixCBaseRow + matrixRows1 * matrixCols2 + variableToRowMap.size();
-    variableToRowMap[varName] = newRow;
+    // A slot past the 16-bit rows is counted, so the program is rejected,
+    // but never handed out
+    int row = tempBaseRow + slot / elementsPerRow;
+    if (row > UINT16_MAX) {
+        return unaddressableTemp;
+    }
+    pool.live++;
+    pool.peak = std::max(pool.peak, pool.live);
     
-    return newRow;
+    // Temporary slots are packed into the rows after the matrices
+    MemoryLocation location;
+    location.row = row;
+    location.col = slot % elementsPerRow;
+    return location;
 }
 
-uint16_t MemoryMapper::getMatrixElementRow(const std::string& matrixName, int row, int col) {
-    if (matrixName == "A") {
-        return matrixABaseRow + row * matrixCols1 + col;
-    } else if (matrixName == "B") {
-        return matrixBBaseRow + row * matrixCols2 + col;
-    } else if (matrixName == "C") {
-        return matrixCBaseRow + row * matrixCols2 + col;
-    } else {
-        std::cerr << "Unknown matrix name: " << matrixName << std::endl;
-        return 0;
+void MemoryMapper::releaseTemp(const MemoryLocation& location) {
+    if (location.row == unaddressableTemp.row && location.col == unaddressableTemp.col) {
+        return;
     }
+    int slot = (location.row - tempBaseRow) * elementsPerRow + location.col;
+    TempPool& pool = tempPools[slot % cores];
+    pool.freeSlots.push(slot);
+    pool.live--;
+}
+
+int MemoryMapper::getPeakTemps() const {
+    int peak = 0;
+    for (const auto& pool : tempPools) {
+        peak += pool.peak;
+    }
+    return peak;
+}
+
+int MemoryMapper::getPeakTempRows() const {
+    return (tempSlotsUsed() + elementsPerRow - 1) / elementsPerRow;
+}
+
+int MemoryMapper::tempSlotsUsed() const {
+    int used = 0;
+    for (int core = 0; core < cores; core++) {
+        if (tempPools[core].slotsTaken > 0) {
+            used = std::max(used, (tempPools[core].slotsTaken - 1) * cores + core + 1);
+        }
+    }
+    return used;
+}
+
+int MemoryMapper::getElementsPerRow() const {
+    return elementsPerRow;
+}
+
+bool MemoryMapper::isTemporaryRow(int row) const {
+    return row >= tempBaseRow;
 }
 
 int MemoryMapper::getTotalRowsNeeded() const {
-    return matrixCBaseRow + matrixRows1 * matrixCols2 + variableToRowMap.size();
+    return tempBaseRow + getPeakTempRows();
 }
\ No newline at end of file
@@ -2,36 +2,135 @@
 #define MEMORY_MAPPER_H
 
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <queue>
+#include <vector>
+#include <functional>
 #include <cstdint>  // Add this include for uint16_t
+#include "data_layout.h"
+#include "loop_nest.h"
+
+// Location of a scalar in DRAM: the row and the column (lane) within it
+struct MemoryLocation {
+    uint16_t row;
+    uint16_t col;
+};
 
 class MemoryMapper {
 public:
-    MemoryMapper(int rows1, int cols1, int rows2, int cols2);
+    // Place the arrays of a loop nest, with their parsed shapes; a matrix's
+    // number is the index of its array in the nest
+    MemoryMapper(const std::vector<ArrayShape>& arrays, int elementsPerRow, int rowsPerSubarray);
+    
+    // Get the number of the matrix with this name, or -1 if there is none
+    int matrixIndex(const std::string& matrixName) const;
+    
+    // Lay a matrix out in this order; the matrices are placed again, so this
+    // must be done before any location is handed out
+    void setLayout(int matrix, const DataLayout& layout);
+    
+    // Get the layout of a matrix
+    const DataLayout& getLayout(int matrix) const;
+    
+    // Get the location of a matrix element
+    MemoryLocation getMatrixElementLocation(int matrix, int row, int col) const;
+    
+    // Estimate the DRAM rows a block of rows x cols elements of a matrix
+    // touches, taking the block as aligned to the layout
+    long regionRows(int matrix, long rows, long cols) const;
+    
+    // Map a constant to the slot holding its value
+    MemoryLocation mapConstant(int value);
+    
+    // Get the slot of a constant mapped before; unlike mapConstant, this is
+    // safe to call from several threads
+    MemoryLocation constantLocation(int value) const;
+    
+    // Give every core its own pool of temporary slots; must be done before
+    // any temporary is allocated
+    void setCores(int cores);
     
-    // Map a variable to a DRAM row address
-    uint16_t mapVariableToRow(const std::string& varName);
+    // Take the lowest free temporary slot the core used before, or a new one
+    // of its own; cores do not share slots, so reusing one needs no
+    // synchronization. Threads may allocate and release concurrently as long
+    // as each sticks to its own cores.
+    MemoryLocation allocateTemp(int core = 0);
     
-    // Get the row address for a matrix element
-    uint16_t getMatrixElementRow(const std::string& matrixName, int row, int col);
+    // Return a temporary's slot so that a later temporary can reuse it
+    void releaseTemp(const MemoryLocation& location);
     
-    // Get the total number of rows needed
+    // Get the number of temporaries live at once, summing the largest number
+    // on every core, and the rows they take
+    int getPeakTemps() const;
+    int getPeakTempRows() const;
+    
+    // Get the number of elements stored in one row
+    int getElementsPerRow() const;
+    
+    // Whether a row holds temporaries rather than matrix elements
+    bool isTemporaryRow(int row) const;
+    
+    // Get the total number of rows needed: the matrices, then the temporaries
+    // allocated so far
     int getTotalRowsNeeded() const;
     
 private:
-    // Matrix dimensions
-    int matrixRows1, matrixCols1, matrixRows2, matrixCols2;
+    // Elements packed in one DRAM row, and DRAM rows in one subarray
+    int elementsPerRow;
+    int rowsPerSubarray;
+    
+    // Placement of a matrix. Its elements are grouped into lines (a matrix
+    // row, a column or a block, depending on the layout); every line starts
+    // a new DRAM row and takes lineStride of them.
+    struct MatrixPlacement {
+        std::string name;
+        int rows = 0;
+        int cols = 0;
+        DataLayout layout;
+        int baseRow = 0;
+        int lineStride = 1;
+        int blockRows = 1;   // Extent of the block held by one BLOCKED or
+        int blockCols = 1;   // MORTON line
+        int lineCount = 0;
+    };
+    std::vector<MatrixPlacement> matrices;
+    
+    // First row holding temporaries; temporaries occupy slots packed
+    // elementsPerRow to a row. Slot s belongs to core s % cores, and freed
+    // slots are reused lowest first by their core. Rows are counted in full
+    // here, so getTotalRowsNeeded sees a layout that does not fit; a slot
+    // whose row does not fit 16 bits is handed out as unaddressableTemp.
+    int tempBaseRow = 0;
+    int cores = 1;
+    
+    // Temporary slots of one core, kept apart from the other cores' so
+    // threads working for different cores do not share a cache line
+    struct alignas(64) TempPool {
+        int slotsTaken = 0;
+        int live = 0;
+        int peak = 0;
+        std::priority_queue<int, std::vector<int>, std::greater<int>> freeSlots;
+    };
+    std::vector<TempPool> tempPools;
+    
+    // Location given for a temporary past the 16-bit rows, which the
+    // program is rejected for; releasing it returns nothing to a pool
+    static constexpr MemoryLocation unaddressableTemp = {UINT16_MAX, UINT16_MAX};
+    
+    // Number of slots up to the highest one taken
+    int tempSlotsUsed() const;
+    
+    // Slots of the constants mapped so far
+    std::unordered_map<int, MemoryLocation> constantLocations;
     
-    // Base row addresses for matrices
-    uint16_t matrixABaseRow;
-    uint16_t matrixBBaseRow;
-    uint16_t matrixCBaseRow;
+    // Number of DRAM rows a line of the given length takes
+    int rowsPerLine(int length) const;
     
-    // Map of variable names to row addresses
-    std::map<std::string, uint16_t> variableToRowMap;
+    // Work out the line geometry of every matrix and where each one starts
+    void placeMatrices();
     
-    // Initialize the mapping
-    void initializeMapping();
+    // Round a row address up to the start of a subarray
+    int alignToSubarray(int row) const;
 };
 
 #endif // MEMORY_MAPPER_H
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "operand_forwarder.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Key of a row and column
+uint32_t locationKey(const PimInstruction& inst) {
+    return (static_cast<uint32_t>(inst.row_addr) << 16) | inst.col_addr;
+}
+
+// Number of cores the instructions name
+int countCores(const std::vector<PimInstruction>& instructions) {
+    int cores = 1;
+    for (const auto& inst : instructions) {
+        cores = std::max(cores, inst.core_id + 1);
+    }
+    return cores;
+}
+
+} // namespace
+
+void OperandForwarder::forward(std::vector<PimInstruction>& instructions) {
+    // Only locations nobody writes hold the same value all along
+    std::unordered_set<uint32_t> written;
+    for (const auto& inst : instructions) {
+        if (inst.opcode == Opcode::STORE ||
+            (inst.opcode == Opcode::MOVE && (inst.flags & (Flags::WRITE | Flags::RESET))) ||
+            (inst.opcode == Opcode::COMPUTE && (inst.flags & Flags::ACCUMULATE))) {
+            written.insert(locationKey(inst));
+        }
+    }
+    
+    // The first load of every location in the current wave
+    struct Load {
+        long wave;
+        long index;
+    };
+    std::unordered_map<uint32_t, Load> firstLoads;
+    std::vector<long> coreWave(countCores(instructions), -1);
+    long wave = 0;
+    int runCore = -1;
+    
+    for (long i = 0; i < static_cast<long>(instructions.size()); i++) {
+        auto& inst = instructions[i];
+        int core = inst.core_id;
+        
+        // A core starting a new tile in the wave it already ran in starts the
+        // next wave
+        if (core != runCore) {
+            if (coreWave[core] == wave) {
+                wave++;
+            }
+            coreWave[core] = wave;
+            runCore = core;
+        }
+        
+        uint32_t key = locationKey(inst);
+        if (inst.opcode != Opcode::LOAD || written.count(key) > 0) {
+            continue;
+        }
+        auto first = firstLoads.find(key);
+        if (first == firstLoads.end() || first->second.wave != wave) {
+            firstLoads[key] = {wave, i};
+            continue;
+        }
+        
+        // Another core of the wave loaded it: take its broadcast
+        auto& source = instructions[first->second.index];
+        if (source.core_id == core) {
+            continue;
+        }
+        if (!(source.flags & Flags::PARALLEL)) {
+            source.flags |= Flags::PARALLEL;
+            broadcasts++;
+        }
+        inst.opcode = Opcode::MOVE;
+        inst.flags = Flags::READ | Flags::PARALLEL;
+        forwarded++;
+    }
+}
+
+long OperandForwarder::getForwarded() const {
+    return forwarded;
+}
+
+long OperandForwarder::getBroadcasts() const {
+    return broadcasts;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef OPERAND_FORWARDER_H
+#define OPERAND_FORWARDER_H
+
+#include "../include/pim_isa.h"
+#include <vector>
+
+// Forwards operands between cores instead of loading them from DRAM again.
+// Tiles generated one after the other on different cores run side by side;
+// a run of such tiles, up to the first core to come back, is a wave. Within
+// a wave, the first core to load an element nobody writes broadcasts it
+// (LOAD with PARALLEL), and the other cores loading it take it from that
+// broadcast (MOVE with READ | PARALLEL) over the links between the cores.
+// A forwarded MOVE waits for its broadcast by itself, so it needs no SYNC.
+class OperandForwarder {
+public:
+    // Forward the operands of the instructions in place
+    void forward(std::vector<PimInstruction>& instructions);
+    
+    // Get the number of loads turned into forwarded MOVEs, and the number of
+    // loads broadcasting to them
+    long getForwarded() const;
+    long getBroadcasts() const;
+    
+private:
+    long forwarded = 0;
+    long broadcasts = 0;
+};
+
+#endif // OPERAND_FORWARDER_H
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "paper_encoder.h"
+#include <climits>
+#include <iostream>
+#include <unordered_map>
+
+PaperISAInstruction PaperEncoder::lower(const PimInstruction& inst) {
+    PaperISAInstruction result;
+    
+    // Default values
+    result.pointer = inst.core_id;  // Use core ID as pointer
+    result.rowAddr = inst.row_addr;
+    
+    // Map opcodes to paper's format
+    switch (inst.opcode) {
+        case Opcode::PROGRAM_LUT:
+            result.opType = 1;  // PROG
+            break;
+        case Opcode::COMPUTE:
+            result.opType = 2;  // EXE
+            result.pointer = inst.flags;  // Use flags as operation pointer
+            break;
+        case Opcode::SYNC:
+            result.opType = 3;  // END
+            break;
+        case Opcode::LOAD:
+            result.readBit = true;
+            break;
+        case Opcode::STORE:
+            result.writeBit = true;
+            break;
+        case Opcode::MOVE:
+            result.readBit = true;
+            result.writeBit = true;
+            break;
+        default:
+            break;
+    }
+    
+    return result;
+}
+
+bool PaperEncoder::addressesRow(const PimInstruction& inst) {
+    return inst.opcode == Opcode::LOAD || inst.opcode == Opcode::STORE || inst.opcode == Opcode::MOVE ||
+           (inst.opcode == Opcode::COMPUTE && (inst.flags & Flags::ACCUMULATE));
+}
+
+bool PaperEncoder::encode(const std::vector<PimInstruction>& instructions, std::vector<PaperISAInstruction>& paper) {
+    rejected = 0;
+    baseLoads = 0;
+    paper.clear();
+    paper.reserve(instructions.size());
+    long count = instructions.size();
+    
+    // Next access of the same core to the same segment, found backwards
+    std::vector<long> nextUse(count, LONG_MAX);
+    std::unordered_map<uint32_t, long> later;
+    for (long i = count - 1; i >= 0; i--) {
+        const auto& inst = instructions[i];
+        if (!addressesRow(inst)) {
+            continue;
+        }
+        uint32_t key = static_cast<uint32_t>(inst.core_id) << 16 | inst.row_addr / PaperISAInstruction::segmentRows;
+        auto next = later.find(key);
+        if (next != later.end()) {
+            nextUse[i] = next->second;
+        }
+        later[key] = i;
+    }
+    
+    // Segment every core's base registers hold (-1 if none) and when the core
+    // accesses it next
+    struct BaseRegister {
+        int segment = -1;
+        long nextUse = LONG_MAX;
+    };
+    std::vector<std::vector<BaseRegister>> bases;
+    
+    for (long i = 0; i < count; i++) {
+        const auto& inst = instructions[i];
+        if (inst.opcode == Opcode::REPEAT || inst.row_stride != 0 || inst.col_stride != 0) {
+            reject(i, inst, "the format has no loops");
+            continue;
+        }
+        if (inst.col_addr != 0) {
+            reject(i, inst, "the format has no column");
+            continue;
+        }
+        PaperISAInstruction lowered = lower(inst);
+        
+        // The row goes through a base register of the core the pointer names;
+        // an EXE's pointer holds its operation instead
+        if (addressesRow(inst) && lowered.pointer != inst.core_id) {
+            reject(i, inst, "the pointer does not name the core whose base register holds the row");
+            continue;
+        }
+        
+        // A row is reached through the register holding its segment. When no
+        // register does, the one whose segment is needed again the latest is
+        // loaded; an empty register is never needed.
+        if (addressesRow(inst)) {
+            if (inst.core_id >= bases.size()) {
+                bases.resize(inst.core_id + 1, std::vector<BaseRegister>(PaperISAInstruction::baseRegisters));
+            }
+            auto& registers = bases[inst.core_id];
+            int segment = inst.row_addr / PaperISAInstruction::segmentRows;
+            int reg = 0;
+            while (reg < PaperISAInstruction::baseRegisters && registers[reg].segment != segment) {
+                reg++;
+            }
+            if (reg == PaperISAInstruction::baseRegisters) {
+                reg = 0;
+                for (int r = 1; r < PaperISAInstruction::baseRegisters; r++) {
+                    if (registers[r].nextUse > registers[reg].nextUse) {
+                        reg = r;
+                    }
+                }
+                PaperISAInstruction base;
+                base.pointer = inst.core_id;
+                base.rowAddr = segment;
+                base.baseReg = reg;
+                base.setBase = true;
+                paper.push_back(base);
+                baseLoads++;
+                registers[reg].segment = segment;
+            }
+            registers[reg].nextUse = nextUse[i];
+            lowered.rowAddr = inst.row_addr % PaperISAInstruction::segmentRows;
+            lowered.baseReg = reg;
+        }
+        
+        // Decode the word again and check that it names the same row
+        PaperISAInstruction decoded = PaperISAInstruction::fromBinary(lowered.toBinary());
+        if (!(decoded == lowered)) {
+            reject(i, inst, decoded.pointer != lowered.pointer ? "the pointer does not fit 6 bits"
+                                                               : "the row does not fit 8 bits");
+            continue;
+        }
+        paper.push_back(lowered);
+    }
+    if (rejected > 0) {
+        std::cerr << rejected << " of " << instructions.size() << " instructions cannot be encoded in the paper's format"
+                  << std::endl;
+    }
+    return rejected == 0;
+}
+
+long PaperEncoder::getRejected() const {
+    return rejected;
+}
+
+long PaperEncoder::getBaseLoads() const {
+    return baseLoads;
+}
+
+void PaperEncoder::reject(long index, const PimInstruction& inst, const char* problem) {
+    if (rejected++ < maxReported) {
+        std::cerr << "Instruction " << index << " (" << inst.toString() << ") cannot be encoded: " << problem
+                  << std::endl;
+    }
+}
+
+void PaperEncoder::print(const std::vector<PaperISAInstruction>& instructions, std::ostream& out) {
+    printHeader(out);
+    for (const auto& inst : instructions) {
+        out << inst.toString() << '\n';
+    }
+}
+
+void PaperEncoder::printHeader(std::ostream& out) {
+    out << "# PIM ISA Instructions in Paper Format (24-bit)" << std::endl;
+    out << "# Format: [Hex] [OpType] ptr=[Pointer] rd=[ReadBit] wr=[WriteBit] row=[RowAddress] base=[BaseRegister]"
+        << std::endl;
+    out << "# BASE loads the segment in row (" << PaperISAInstruction::segmentRows
+        << " rows each) into base register base of core ptr" << std::endl;
+    out << std::endl;
+}
\ No newline at end of file
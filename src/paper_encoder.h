@@ -0,0 +1,49 @@
+#ifndef PAPER_ENCODER_H
+#define PAPER_ENCODER_H
+
+#include "../include/pim_isa.h"
+#include "../include/paper_isa.h"
+#include <ostream>
+#include <vector>
+
+// Lowers instructions to the 24-bit format of the paper. The format addresses
+// whole rows, so an instruction naming a column other than 0 is rejected. A
+// row a core reads or writes is given relative to one of the base registers
+// of the core the pointer names, and a BASE instruction is placed wherever the
+// core reaches a segment none of them holds; an EXE whose pointer holds its
+// operation cannot address a row. Every instruction is checked by encoding it
+// and decoding it again, so a value the format cannot hold is reported
+// instead of truncated.
+class PaperEncoder {
+public:
+    // Lower an instruction, copying its fields whole
+    static PaperISAInstruction lower(const PimInstruction& inst);
+    
+    // Whether an instruction's row is a location the core reads or writes
+    static bool addressesRow(const PimInstruction& inst);
+    
+    // Lower a program in one pass; fails if any instruction does not survive
+    bool encode(const std::vector<PimInstruction>& instructions, std::vector<PaperISAInstruction>& paper);
+    
+    // Get the number of instructions that did not survive
+    long getRejected() const;
+    
+    // Get the number of BASE instructions placed
+    long getBaseLoads() const;
+    
+    // Write a listing of instructions in the paper's format
+    static void print(const std::vector<PaperISAInstruction>& instructions, std::ostream& out);
+    static void printHeader(std::ostream& out);
+    
+private:
+    long rejected = 0;
+    long baseLoads = 0;
+    
+    // Number of rejected instructions reported one by one
+    static constexpr long maxReported = 8;
+    
+    // Report an instruction that cannot be encoded
+    void reject(long index, const PimInstruction& inst, const char* problem);
+};
+
+#endif // PAPER_ENCODER_H
\ No newline at end of file
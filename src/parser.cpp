@@ -1,40 +1,124 @@
 #include "parser.h"
+#include <llvm/Config/llvm-config.h>
+#if LLVM_VERSION_MAJOR >= 17
+#include <llvm/TargetParser/Triple.h>
+#else
+#include <llvm/ADT/Triple.h>
+#endif
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Dominators.h>
 #include <llvm/IR/Instructions.h>
-#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Operator.h>
 #include <llvm/IRReader/IRReader.h>
 #include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Analysis/AssumptionCache.h>
 #include <llvm/Analysis/LoopInfo.h>
-#include <llvm/Transforms/Utils.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Transforms/Utils/PromoteMemToReg.h>
 #include <iostream>
+#include <algorithm>
+#include <functional>
 
-std::string ThreeAddressInst::toString() const {
-    std::string result;
-    switch (op) {
-        case OpType::LOAD: result = dest + " = LOAD " + src1; break;
-        case OpType::STORE: result = "STORE " + src1 + " to " + dest; break;
-        case OpType::ADD: result = dest + " = " + src1 + " + " + src2; break;
-        case OpType::MULTIPLY: result = dest + " = " + src1 + " * " + src2; break;
-        case OpType::MOVE: result = dest + " = " + src1; break;
+namespace {
+
+// Split an integer or pointer SCEV into constant + sum(coeffs[d] * iv[d]) over the loops
+// of the nest. Pointer expressions must be rooted at 'base', which is dropped.
+bool decomposeAffine(const llvm::SCEV* expr, int64_t scale,
+                     const std::vector<llvm::Loop*>& nest, const llvm::SCEV* base,
+                     std::vector<int64_t>& coeffs, int64_t& constant) {
+    if (auto* c = llvm::dyn_cast<llvm::SCEVConstant>(expr)) {
+        constant += scale * c->getAPInt().getSExtValue();
+        return true;
+    }
+    if (auto* addRec = llvm::dyn_cast<llvm::SCEVAddRecExpr>(expr)) {
+        auto it = std::find(nest.begin(), nest.end(), addRec->getLoop());
+        auto* step = llvm::dyn_cast<llvm::SCEVConstant>(addRec->getOperand(1));
+        if (it == nest.end() || !addRec->isAffine() || !step) {
+            return false;
+        }
+        coeffs[it - nest.begin()] += scale * step->getAPInt().getSExtValue();
+        return decomposeAffine(addRec->getStart(), scale, nest, base, coeffs, constant);
+    }
+    if (auto* add = llvm::dyn_cast<llvm::SCEVAddExpr>(expr)) {
+        for (const llvm::SCEV* op : add->operands()) {
+            if (!decomposeAffine(op, scale, nest, base, coeffs, constant)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (auto* mul = llvm::dyn_cast<llvm::SCEVMulExpr>(expr)) {
+        auto* factor = llvm::dyn_cast<llvm::SCEVConstant>(mul->getOperand(0));
+        if (mul->getNumOperands() != 2 || !factor) {
+            return false;
+        }
+        return decomposeAffine(mul->getOperand(1), scale * factor->getAPInt().getSExtValue(),
+                               nest, base, coeffs, constant);
+    }
+    if (auto* cast = llvm::dyn_cast<llvm::SCEVCastExpr>(expr)) {
+        return decomposeAffine(cast->getOperand(), scale, nest, base, coeffs, constant);
+    }
+    return expr == base;
+}
+
+std::string inductionVarName(int depth) {
+    static const std::string names = "ijklmn";
+    if (depth < static_cast<int>(names.size())) {
+        return std::string(1, names[depth]);
     }
-    return result;
+    return "i" + std::to_string(depth);
+}
+
+// Text of an instruction or value for error messages
+std::string describe(const llvm::Value* value) {
+    std::string text;
+    llvm::raw_string_ostream stream(text);
+    value->print(stream);
+    stream.flush();
+    return text.substr(std::min(text.find_first_not_of(' '), text.size()));
 }
 
-Parser::Parser() : matrixRows1(0), matrixCols1(0), matrixRows2(0), matrixCols2(0) {
+// Look through the single-incoming phis that carry a value out of a loop
+llvm::Value* throughExitPhis(llvm::Value* value) {
+    while (auto* phi = llvm::dyn_cast<llvm::PHINode>(value)) {
+        if (phi->getNumIncomingValues() != 1) {
+            break;
+        }
+        value = phi->getIncomingValue(0);
+    }
+    return value;
+}
+
+} // namespace
+
+Parser::Parser() {
 }
 
 Parser::~Parser() {
 }
 
 bool Parser::parseFile(const std::string& filename) {
-    llvm::LLVMContext context;
     llvm::SMDiagnostic err;
     
+    // The context has to outlive the module parsed into it
+    context = std::make_unique<llvm::LLVMContext>();
+#if LLVM_VERSION_MAJOR == 14
+    // Current clang releases emit opaque pointers, which LLVM 14 only reads on request
+    context->enableOpaquePointers();
+#elif LLVM_VERSION_MAJOR < 17
+    context->setOpaquePointers(true);
+#endif
+
     // Parse the input file to get LLVM IR
-    module = llvm::parseIRFile(filename, err, context);
+    module = llvm::parseIRFile(filename, err, *context);
     
     if (!module) {
         std::cerr << "Error parsing IR file: " << filename << std::endl;
@@ -42,155 +126,593 @@ bool Parser::parseFile(const std::string& filename) {
         return false;
     }
     
-    // Extract matrix dimensions from global variables or function parameters
-    // This is a simplified approach - in a real implementation, you would
-    // analyze the code to determine the dimensions
-    matrixRows1 = matrixCols1 = matrixRows2 = matrixCols2 = 100;  // Default size
+    llvm::Function* kernel = findKernelFunction();
+    if (!kernel) {
+        std::cerr << "Could not find a function with a loop nest in the module" << std::endl;
+        return false;
+    }
     
-    // Generate three-address code from the LLVM IR
-    generateThreeAddressCode();
+    if (!analyzeKernel(*kernel)) {
+        std::cerr << "Could not analyze the loop nest of " << kernelName << std::endl;
+        return false;
+    }
     
     return true;
 }
 
-void Parser::generateThreeAddressCode() {
-    // Clear any existing code
-    threeAddressCode.clear();
+llvm::Function* Parser::findKernelFunction() {
+    llvm::Function* best = nullptr;
+    unsigned bestDepth = 0;
     
-    // Find the main function or the matrix multiplication function
-    llvm::Function* mainFunc = module->getFunction("main");
-    if (!mainFunc) {
-        std::cerr << "Could not find main function in the module" << std::endl;
-        return;
+    for (auto& func : *module) {
+        if (func.isDeclaration()) {
+            continue;
+        }
+        
+        llvm::DominatorTree DT(func);
+        llvm::LoopInfo LI(DT);
+        unsigned depth = 0;
+        for (llvm::Loop* loop : LI.getLoopsInPreorder()) {
+            depth = std::max(depth, loop->getLoopDepth());
+        }
+        
+        // A deeper nest wins; on a tie, the driver (main) loses to the kernel it calls
+        bool isMain = func.getName() == "main";
+        if (depth > bestDepth || (depth == bestDepth && depth > 0 && best &&
+                                  best->getName() == "main" && !isMain)) {
+            best = &func;
+            bestDepth = depth;
+        }
     }
     
-    // Create a loop info pass to identify loops
-    llvm::legacy::FunctionPassManager FPM(module.get());
-    llvm::LoopInfo* LI = new llvm::LoopInfo();
+    return best;
+}
+
+bool Parser::analyzeKernel(llvm::Function& func) {
+    kernelName = func.getName().str();
+    nest = LoopNest();
+    llvmLoops.clear();
+    arrayBases.clear();
+    inductionPhis.clear();
+    reductions.clear();
+    reductionValues.clear();
+    
+    llvm::DominatorTree DT(func);
+    llvm::AssumptionCache AC(func);
     
-    // Analyze the function to find loops
-    for (auto& BB : *mainFunc) {
+    // Promote the -O0 stack slots so induction variables become SCEV recurrences
+    std::vector<llvm::AllocaInst*> allocas;
+    for (auto& I : func.getEntryBlock()) {
+        if (auto* alloca = llvm::dyn_cast<llvm::AllocaInst>(&I)) {
+            if (llvm::isAllocaPromotable(alloca)) {
+                allocas.push_back(alloca);
+            }
+        }
+    }
+    if (!allocas.empty()) {
+        llvm::PromoteMemToReg(allocas, DT, &AC);
+    }
+    
+    llvm::LoopInfo LI(DT);
+    llvm::TargetLibraryInfoImpl TLII(llvm::Triple(module->getTargetTriple()));
+    llvm::TargetLibraryInfo TLI(TLII);
+    llvm::ScalarEvolution SE(func, TLI, AC, DT, LI);
+    
+    // The kernel is a single perfectly chained nest: one top-level loop, and
+    // at most one loop directly inside each loop
+    if (LI.getTopLevelLoops().size() != 1) {
+        std::cerr << kernelName << " has " << LI.getTopLevelLoops().size()
+                  << " top-level loop nests; only a single nest can be compiled" << std::endl;
+        return false;
+    }
+    for (llvm::Loop* current = LI.getTopLevelLoops()[0]; current;
+         current = current->getSubLoops().empty() ? nullptr : current->getSubLoops()[0]) {
+        if (current->getSubLoops().size() > 1) {
+            std::cerr << "The loop at depth " << llvmLoops.size() << " holds "
+                      << current->getSubLoops().size() << " sibling loops; only one can be compiled" << std::endl;
+            return false;
+        }
+        llvmLoops.push_back(current);
+    }
+    
+    // Stores are only translated inside the nest; anything else writing
+    // memory would be lost
+    for (auto& BB : func) {
+        llvm::Loop* loop = LI.getLoopFor(&BB);
         for (auto& I : BB) {
+            if (!I.mayWriteToMemory() || I.isLifetimeStartOrEnd() || llvm::isa<llvm::DbgInfoIntrinsic>(&I)) {
+                continue;
+            }
+            if (!loop) {
+                std::cerr << "Memory is written outside the loop nest: " << describe(&I) << std::endl;
+                return false;
+            }
+            if (!llvm::isa<llvm::StoreInst>(&I)) {
+                std::cerr << "Unsupported instruction in the loop at depth " << loop->getLoopDepth() - 1
+                          << ": " << describe(&I) << std::endl;
+                return false;
+            }
+        }
+    }
+    
+    for (size_t depth = 0; depth < llvmLoops.size(); depth++) {
+        if (!processLoop(llvmLoops[depth], depth, SE)) {
+            return false;
+        }
+    }
+    if (!findReductions(SE)) {
+        return false;
+    }
+    
+    // The loops' bodies are translated outermost first, so that values
+    // defined before a nested loop are known inside it, and then put in
+    // program order
+    std::map<llvm::Value*, Operand> values;
+    for (size_t depth = 0; depth < llvmLoops.size(); depth++) {
+        if (!processLoopBody(llvmLoops[depth], depth, LI, DT, SE, values)) {
+            return false;
+        }
+    }
+    orderBody();
+    
+    // Arrays passed as plain pointers get their extent from the largest subscript used
+    std::vector<ArrayShape> declared = nest.arrays;
+    for (const auto& access : nest.accesses) {
+        auto extent = [&](const AffineIndex& index) {
+            int value = index.constant;
+            for (size_t d = 0; d < index.coeffs.size(); d++) {
+                value += std::max(index.coeffs[d] * nest.loops[d].lowerBound,
+                                  index.coeffs[d] * nest.loops[d].upperBound);
+            }
+            return value + 1;
+        };
+        auto& shape = nest.arrays[access.array];
+        if (declared[access.array].rows <= 0) {
+            shape.rows = std::max(shape.rows, extent(access.row));
+        }
+        if (declared[access.array].cols <= 0) {
+            shape.cols = std::max(shape.cols, extent(access.col));
+        }
+    }
+    
+    // The llvm::Loop objects die with LoopInfo
+    llvmLoops.clear();
+    
+    return !nest.body.empty();
+}
+
+bool Parser::processLoop(llvm::Loop* loop, int depth, llvm::ScalarEvolution& SE) {
+    // The induction variable is the header phi that SCEV sees as {start,+,step}
+    const llvm::SCEVAddRecExpr* induction = nullptr;
+    llvm::PHINode* inductionPhi = nullptr;
+    for (auto& phi : loop->getHeader()->phis()) {
+        if (!phi.getType()->isIntegerTy()) {
+            continue;
+        }
+        auto* addRec = llvm::dyn_cast<llvm::SCEVAddRecExpr>(SE.getSCEV(&phi));
+        if (addRec && addRec->getLoop() == loop && addRec->isAffine() &&
+            llvm::isa<llvm::SCEVConstant>(addRec->getStart()) &&
+            llvm::isa<llvm::SCEVConstant>(addRec->getOperand(1))) {
+            induction = addRec;
+            inductionPhi = &phi;
+            break;
+        }
+    }
+    if (!induction) {
+        std::cerr << "Loop at depth " << depth << " has no affine induction variable" << std::endl;
+        return false;
+    }
+    
+    llvm::BasicBlock* exiting = loop->getExitingBlock();
+    if (!exiting) {
+        std::cerr << "Loop at depth " << depth << " has more than one exit" << std::endl;
+        return false;
+    }
+    auto* exitCount = llvm::dyn_cast<llvm::SCEVConstant>(SE.getExitCount(loop, exiting));
+    if (!exitCount) {
+        std::cerr << "Loop at depth " << depth << " has no constant trip count" << std::endl;
+        return false;
+    }
+    
+    // A loop exiting from its header runs the body once per backedge; a rotated
+    // loop (exit in the latch) runs it once more
+    int tripCount = exitCount->getAPInt().getSExtValue();
+    if (exiting == loop->getLoopLatch()) {
+        tripCount++;
+    }
+    if (tripCount <= 0) {
+        std::cerr << "Loop at depth " << depth << " never executes" << std::endl;
+        return false;
+    }
+    
+    LoopBounds bounds;
+    bounds.inductionVar = inductionVarName(depth);
+    bounds.depth = depth;
+    bounds.lowerBound = llvm::cast<llvm::SCEVConstant>(induction->getStart())->getAPInt().getSExtValue();
+    bounds.step = llvm::cast<llvm::SCEVConstant>(induction->getOperand(1))->getAPInt().getSExtValue();
+    bounds.tripCount = tripCount;
+    bounds.upperBound = bounds.lowerBound + (tripCount - 1) * bounds.step;
+    nest.loops.push_back(bounds);
+    inductionPhis.push_back(inductionPhi);
+    
+    return true;
+}
+
+bool Parser::findReductions(llvm::ScalarEvolution& SE) {
+    const llvm::DataLayout& DL = module->getDataLayout();
+    
+    for (size_t depth = 0; depth < llvmLoops.size(); depth++) {
+        llvm::Loop* loop = llvmLoops[depth];
+        for (auto& phi : loop->getHeader()->phis()) {
+            // Induction variables, and pointers advanced like them, are
+            // handled by ScalarEvolution
+            auto* addRec = llvm::dyn_cast<llvm::SCEVAddRecExpr>(SE.getSCEV(&phi));
+            if (&phi == inductionPhis[depth] || (addRec && addRec->getLoop() == loop)) {
+                continue;
+            }
+            
+            // The slot is indexed by the enclosing loops, the outer one
+            // selecting the row and the inner one the column
+            if (!loop->getLoopPreheader() || !loop->getLoopLatch() || depth == 0 || depth > 2) {
+                std::cerr << "Unsupported scalar carried around the loop at depth " << depth
+                          << ": " << describe(&phi) << std::endl;
+                return false;
+            }
+            
+            Reduction reduction;
+            reduction.phi = &phi;
+            reduction.latchValue = phi.getIncomingValueForBlock(loop->getLoopLatch());
+            reduction.depth = depth;
+            
+            ArrayShape shape;
+            shape.name = "acc" + std::to_string(reductions.size());
+            shape.rows = 1;
+            shape.elementSize = DL.getTypeAllocSize(phi.getType());
+            reduction.access.array = nest.arrays.size();
+            reduction.access.row.coeffs.assign(llvmLoops.size(), 0);
+            reduction.access.col.coeffs.assign(llvmLoops.size(), 0);
+            for (size_t outer = 0; outer < depth; outer++) {
+                const auto& bounds = nest.loops[outer];
+                int first = std::min(bounds.lowerBound, bounds.upperBound);
+                int extent = std::max(bounds.lowerBound, bounds.upperBound) - first + 1;
+                AffineIndex& index = outer + 1 == depth ? reduction.access.col : reduction.access.row;
+                index.coeffs[outer] = 1;
+                index.constant = -first;
+                (outer + 1 == depth ? shape.cols : shape.rows) = extent;
+            }
+            nest.arrays.push_back(shape);
+            arrayBases.push_back(nullptr);
+            
+            reductionValues[reduction.phi] = reductions.size();
+            if (llvm::isa<llvm::Instruction>(reduction.latchValue)) {
+                reductionValues[reduction.latchValue] = reductions.size();
+            }
+            reductions.push_back(reduction);
+        }
+    }
+    
+    return true;
+}
+
+bool Parser::processLoopBody(llvm::Loop* loop, int depth, llvm::LoopInfo& LI,
+                             llvm::DominatorTree& DT, llvm::ScalarEvolution& SE,
+                             std::map<llvm::Value*, Operand>& values) {
+    llvm::Loop* inner = depth + 1 < static_cast<int>(llvmLoops.size()) ? llvmLoops[depth + 1] : nullptr;
+    int level = depth;
+    bool afterInner = false;
+    
+    auto unsupported = [&](const char* what, llvm::Value* value) {
+        std::cerr << what << " in the loop at depth " << depth << ": " << describe(value) << std::endl;
+        return false;
+    };
+    
+    // Values computed from array elements, as opposed to induction variables and addresses
+    auto isData = [&](llvm::Value* value) {
+        value = throughExitPhis(value);
+        return values.count(value) > 0 || reductionValues.count(value) > 0;
+    };
+    
+    // A reduction used after its loop is read back from its slot
+    auto operandOf = [&](llvm::Value* value, Operand& operand) {
+        value = throughExitPhis(value);
+        if (auto* constant = llvm::dyn_cast<llvm::ConstantInt>(value)) {
+            operand = LoopNest::constant(constant->getSExtValue());
+            return true;
+        }
+        auto it = values.find(value);
+        if (it != values.end()) {
+            operand = it->second;
+            return true;
+        }
+        auto reduction = reductionValues.find(value);
+        if (reduction == reductionValues.end()) {
+            return false;
+        }
+        ThreeAddressInst load;
+        load.op = ThreeAddressInst::OpType::LOAD;
+        load.dest = nest.newTemp();
+        load.src1 = nest.addAccess(reductions[reduction->second].access);
+        load.depth = level;
+        load.afterInner = afterInner;
+        nest.body.push_back(load);
+        operand = load.dest;
+        return true;
+    };
+    
+    // Reductions of this loop start, before it, from the value they enter it with
+    for (const auto& reduction : reductions) {
+        if (reduction.depth != depth) {
+            continue;
+        }
+        ThreeAddressInst init;
+        init.depth = level;
+        init.afterInner = false;
+        llvm::Value* start = reduction.phi->getIncomingValueForBlock(loop->getLoopPreheader());
+        if (!operandOf(start, init.src1)) {
+            return unsupported("Unsupported initial value of a reduction", reduction.phi);
+        }
+        init.op = init.src1.kind == Operand::Kind::CONSTANT
+                      ? ThreeAddressInst::OpType::MOVE
+                      : ThreeAddressInst::OpType::STORE;
+        init.dest = nest.addAccess(reduction.access);
+        nest.body.push_back(init);
+    }
+    
+    level = depth + 1;
+    for (auto& BB : *loop->getHeader()->getParent()) {
+        if (LI.getLoopFor(&BB) != loop) {
+            continue;
+        }
+        afterInner = inner && !DT.dominates(&BB, inner->getHeader());
+        
+        for (auto& I : BB) {
+            ThreeAddressInst op;
+            op.depth = level;
+            op.afterInner = afterInner;
+            
             if (auto* load = llvm::dyn_cast<llvm::LoadInst>(&I)) {
-                // Process load instruction
-                ThreeAddressInst tai;
-                tai.op = ThreeAddressInst::OpType::LOAD;
-                tai.dest = "t" + std::to_string(threeAddressCode.size());
-                tai.src1 = load->getPointerOperand()->getName().str();
-                threeAddressCode.push_back(tai);
+                ArrayAccess access;
+                if (!resolveArrayAccess(load->getPointerOperand(), load->getType(), SE, access)) {
+                    return unsupported("Unsupported array access", load);
+                }
+                op.op = ThreeAddressInst::OpType::LOAD;
+                op.dest = nest.newTemp();
+                op.src1 = nest.addAccess(access);
+                values[load] = op.dest;
             }
             else if (auto* store = llvm::dyn_cast<llvm::StoreInst>(&I)) {
-                // Process store instruction
-                ThreeAddressInst tai;
-                tai.op = ThreeAddressInst::OpType::STORE;
-                tai.dest = store->getPointerOperand()->getName().str();
-                tai.src1 = "t" + std::to_string(threeAddressCode.size() - 1);
-                threeAddressCode.push_back(tai);
+                ArrayAccess access;
+                if (!resolveArrayAccess(store->getPointerOperand(), store->getValueOperand()->getType(), SE, access)) {
+                    return unsupported("Unsupported array access", store);
+                }
+                if (!operandOf(store->getValueOperand(), op.src1)) {
+                    return unsupported("Stored value is neither an array element nor a constant", store);
+                }
+                op.op = op.src1.kind == Operand::Kind::CONSTANT
+                            ? ThreeAddressInst::OpType::MOVE
+                            : ThreeAddressInst::OpType::STORE;
+                op.dest = nest.addAccess(access);
             }
             else if (auto* binOp = llvm::dyn_cast<llvm::BinaryOperator>(&I)) {
-                // Process binary operations (add, multiply)
-                ThreeAddressInst tai;
-                tai.dest = "t" + std::to_string(threeAddressCode.size());
-                
-                // Get operand names
-                if (auto* op1 = llvm::dyn_cast<llvm::LoadInst>(binOp->getOperand(0))) {
-                    tai.src1 = op1->getPointerOperand()->getName().str();
+                // Induction variable updates and address arithmetic are not statements
+                if (!isData(binOp->getOperand(0)) && !isData(binOp->getOperand(1))) {
+                    continue;
+                }
+                if (binOp->getOpcode() == llvm::Instruction::Add) {
+                    op.op = ThreeAddressInst::OpType::ADD;
+                } else if (binOp->getOpcode() == llvm::Instruction::Mul) {
+                    op.op = ThreeAddressInst::OpType::MULTIPLY;
                 } else {
-                    tai.src1 = "t" + std::to_string(threeAddressCode.size() - 2);
+                    return unsupported("Unsupported instruction", binOp);
+                }
+                if (!operandOf(binOp->getOperand(0), op.src1) ||
+                    !operandOf(binOp->getOperand(1), op.src2)) {
+                    return unsupported("Operand is neither an array element nor a constant", binOp);
                 }
-                
-                if (auto* op2 = llvm::dyn_cast<llvm::LoadInst>(binOp->getOperand(1))) {
-                    tai.src2 = op2->getPointerOperand()->getName().str();
+                op.dest = nest.newTemp();
+                values[binOp] = op.dest;
+            }
+            else if (auto* cast = llvm::dyn_cast<llvm::CastInst>(&I)) {
+                Operand operand;
+                if (isData(cast->getOperand(0)) && operandOf(cast->getOperand(0), operand)) {
+                    values[cast] = operand;
+                }
+                continue;
+            }
+            else if (auto* phi = llvm::dyn_cast<llvm::PHINode>(&I)) {
+                // A reduction is loaded from its slot at the start of each iteration
+                auto reduction = reductionValues.find(phi);
+                if (reduction != reductionValues.end() && reductions[reduction->second].phi == phi) {
+                    op.op = ThreeAddressInst::OpType::LOAD;
+                    op.dest = nest.newTemp();
+                    op.src1 = nest.addAccess(reductions[reduction->second].access);
+                    values[phi] = op.dest;
+                } else if (phi->getNumIncomingValues() == 1 ||
+                           std::none_of(phi->incoming_values().begin(), phi->incoming_values().end(),
+                                        [&](llvm::Value* value) { return isData(value); })) {
+                    continue;
                 } else {
-                    tai.src2 = "t" + std::to_string(threeAddressCode.size() - 1);
+                    return unsupported("Unsupported instruction", phi);
                 }
-                
-                // Determine operation type
-                if (binOp->getOpcode() == llvm::Instruction::Add) {
-                    tai.op = ThreeAddressInst::OpType::ADD;
-                } else if (binOp->getOpcode() == llvm::Instruction::Mul) {
-                    tai.op = ThreeAddressInst::OpType::MULTIPLY;
+            }
+            else {
+                // Anything else may only work on induction variables and addresses
+                for (llvm::Value* operand : I.operands()) {
+                    if (isData(operand)) {
+                        return unsupported("Unsupported instruction", &I);
+                    }
                 }
-                
-                threeAddressCode.push_back(tai);
+                continue;
             }
+            
+            nest.body.push_back(op);
+        }
+    }
+    
+    // Reductions of this loop are stored back to their slot at the end of each iteration
+    afterInner = inner != nullptr;
+    for (const auto& reduction : reductions) {
+        if (reduction.depth != depth) {
+            continue;
+        }
+        ThreeAddressInst update;
+        update.depth = level;
+        update.afterInner = afterInner;
+        if (!operandOf(reduction.latchValue, update.src1)) {
+            return unsupported("Unsupported update of a reduction", reduction.phi);
         }
+        update.op = update.src1.kind == Operand::Kind::CONSTANT
+                        ? ThreeAddressInst::OpType::MOVE
+                        : ThreeAddressInst::OpType::STORE;
+        update.dest = nest.addAccess(reduction.access);
+        nest.body.push_back(update);
     }
     
-    // For demonstration purposes, let's add some matrix multiplication code
-    // In a real implementation, this would be derived from the LLVM IR analysis
+    return true;
+}
+
+bool Parser::resolveArrayAccess(llvm::Value* pointer, llvm::Type* elementType,
+                             llvm::ScalarEvolution& SE, ArrayAccess& access) {
+    const llvm::SCEV* expr = SE.getSCEV(pointer);
+    auto* base = llvm::dyn_cast<llvm::SCEVUnknown>(SE.getPointerBase(expr));
+    if (!base) {
+        return false;
+    }
+    llvm::Value* baseValue = base->getValue();
+    if (!llvm::isa<llvm::Argument>(baseValue) && !llvm::isa<llvm::AllocaInst>(baseValue) &&
+        !llvm::isa<llvm::GlobalVariable>(baseValue)) {
+        return false;
+    }
     
-    // Simplified matrix multiplication in three-address code
-    // for (i = 0; i < N; i++)
-    //   for (j = 0; j < N; j++)
-    //     for (k = 0; k < N; k++)
-    //       C[i][j] += A[i][k] * B[k][j]
+    std::vector<int64_t> byteCoeffs(llvmLoops.size(), 0);
+    int64_t byteOffset = 0;
+    if (!decomposeAffine(expr, 1, llvmLoops, base, byteCoeffs, byteOffset)) {
+        return false;
+    }
     
-    for (int i = 0; i < 3; i++) {  // Just generate a small example
-        for (int j = 0; j < 3; j++) {
-            // Initialize C[i][j] to 0
-            ThreeAddressInst init;
-            init.op = ThreeAddressInst::OpType::MOVE;
-            init.dest = "C_" + std::to_string(i) + "_" + std::to_string(j);
-            init.src1 = "0";
-            threeAddressCode.push_back(init);
-            
-            for (int k = 0; k < 3; k++) {
-                // Load A[i][k]
-                ThreeAddressInst loadA;
-                loadA.op = ThreeAddressInst::OpType::LOAD;
-                loadA.dest = "t_A_" + std::to_string(i) + "_" + std::to_string(k);
-                loadA.src1 = "A_" + std::to_string(i) + "_" + std::to_string(k);
-                threeAddressCode.push_back(loadA);
-                
-                // Load B[k][j]
-                ThreeAddressInst loadB;
-                loadB.op = ThreeAddressInst::OpType::LOAD;
-                loadB.dest = "t_B_" + std::to_string(k) + "_" + std::to_string(j);
-                loadB.src1 = "B_" + std::to_string(k) + "_" + std::to_string(j);
-                threeAddressCode.push_back(loadB);
-                
-                // Multiply A[i][k] * B[k][j]
-                ThreeAddressInst mul;
-                mul.op = ThreeAddressInst::OpType::MULTIPLY;
-                mul.dest = "t_mul_" + std::to_string(i) + "_" + std::to_string(j) + "_" + std::to_string(k);
-                mul.src1 = "t_A_" + std::to_string(i) + "_" + std::to_string(k);
-                mul.src2 = "t_B_" + std::to_string(k) + "_" + std::to_string(j);
-                threeAddressCode.push_back(mul);
-                
-                // Load current C[i][j]
-                ThreeAddressInst loadC;
-                loadC.op = ThreeAddressInst::OpType::LOAD;
-                loadC.dest = "t_C_" + std::to_string(i) + "_" + std::to_string(j);
-                loadC.src1 = "C_" + std::to_string(i) + "_" + std::to_string(j);
-                threeAddressCode.push_back(loadC);
-                
-                // Add to C[i][j]
-                ThreeAddressInst add;
-                add.op = ThreeAddressInst::OpType::ADD;
-                add.dest = "t_C_new_" + std::to_string(i) + "_" + std::to_string(j);
-                add.src1 = "t_C_" + std::to_string(i) + "_" + std::to_string(j);
-                add.src2 = "t_mul_" + std::to_string(i) + "_" + std::to_string(j) + "_" + std::to_string(k);
-                threeAddressCode.push_back(add);
-                
-                // Store back to C[i][j]
-                ThreeAddressInst storeC;
-                storeC.op = ThreeAddressInst::OpType::STORE;
-                storeC.dest = "C_" + std::to_string(i) + "_" + std::to_string(j);
-                storeC.src1 = "t_C_new_" + std::to_string(i) + "_" + std::to_string(j);
-                threeAddressCode.push_back(storeC);
+    // SCEV recurrences count iterations from zero; rebase them onto the
+    // induction variables, which start at lowerBound and advance by step
+    for (size_t d = 0; d < llvmLoops.size(); d++) {
+        const auto& bounds = nest.loops[d];
+        if (byteCoeffs[d] % bounds.step != 0) {
+            return false;
+        }
+        byteCoeffs[d] /= bounds.step;
+        byteOffset -= byteCoeffs[d] * bounds.lowerBound;
+    }
+    
+    const llvm::DataLayout& DL = module->getDataLayout();
+    int64_t elementSize = DL.getTypeAllocSize(elementType);
+    
+    // The row length comes from the declared array type: the allocation itself for
+    // locals and globals, or the array type a pointer parameter is indexed with
+    int rows = 0, cols = 0;
+    llvm::Type* declared = nullptr;
+    if (auto* alloca = llvm::dyn_cast<llvm::AllocaInst>(baseValue)) {
+        declared = alloca->getAllocatedType();
+    } else if (auto* global = llvm::dyn_cast<llvm::GlobalVariable>(baseValue)) {
+        declared = global->getValueType();
+    } else {
+        for (llvm::Value* p = pointer; auto* gep = llvm::dyn_cast<llvm::GEPOperator>(p);
+             p = gep->getPointerOperand()) {
+            if (gep->getSourceElementType()->isArrayTy()) {
+                declared = gep->getSourceElementType();
             }
         }
     }
+    if (auto* outer = llvm::dyn_cast_or_null<llvm::ArrayType>(declared)) {
+        if (auto* inner = llvm::dyn_cast<llvm::ArrayType>(outer->getElementType())) {
+            rows = outer->getNumElements();
+            cols = inner->getNumElements();
+        } else if (llvm::isa<llvm::AllocaInst>(baseValue) || llvm::isa<llvm::GlobalVariable>(baseValue)) {
+            rows = 1;
+            cols = outer->getNumElements();
+        } else {
+            cols = outer->getNumElements();
+        }
+    }
+    int64_t rowBytes = cols > 0 && rows != 1 ? cols * elementSize : 0;
+    
+    // Delinearize the byte offset into row and column subscripts
+    access.row.coeffs.assign(llvmLoops.size(), 0);
+    access.col.coeffs.assign(llvmLoops.size(), 0);
+    for (size_t d = 0; d < llvmLoops.size(); d++) {
+        if (rowBytes && byteCoeffs[d] % rowBytes == 0) {
+            access.row.coeffs[d] = byteCoeffs[d] / rowBytes;
+        } else if (byteCoeffs[d] % elementSize == 0) {
+            access.col.coeffs[d] = byteCoeffs[d] / elementSize;
+        } else {
+            return false;
+        }
+    }
+    int64_t rowOffset = 0;
+    if (rowBytes) {
+        rowOffset = byteOffset / rowBytes;
+        if (byteOffset < rowOffset * rowBytes) {
+            rowOffset--;
+        }
+    }
+    if ((byteOffset - rowOffset * rowBytes) % elementSize != 0) {
+        return false;
+    }
+    access.row.constant = rowOffset;
+    access.col.constant = (byteOffset - rowOffset * rowBytes) / elementSize;
+    
+    auto it = std::find(arrayBases.begin(), arrayBases.end(), baseValue);
+    if (it != arrayBases.end()) {
+        access.array = it - arrayBases.begin();
+        return true;
+    }
+    
+    // Unnamed parameters (the usual case for clang output) are named A, B, C, ...
+    // after their position in the signature
+    ArrayShape shape;
+    if (baseValue->hasName()) {
+        shape.name = baseValue->getName().str();
+    } else if (auto* arg = llvm::dyn_cast<llvm::Argument>(baseValue)) {
+        shape.name = std::string(1, static_cast<char>('A' + arg->getArgNo()));
+    } else {
+        shape.name = "M" + std::to_string(nest.arrays.size());
+    }
+    shape.rows = rows;
+    shape.cols = cols;
+    shape.elementSize = elementSize;
+    
+    access.array = nest.arrays.size();
+    nest.arrays.push_back(shape);
+    arrayBases.push_back(baseValue);
+    
+    return true;
+}
+
+void Parser::orderBody() {
+    std::vector<ThreeAddressInst> ordered;
+    ordered.reserve(nest.body.size());
+    
+    std::function<void(int)> placeLevel = [&](int level) {
+        for (const auto& inst : nest.body) {
+            if (inst.depth == level && !inst.afterInner) {
+                ordered.push_back(inst);
+            }
+        }
+        if (level < static_cast<int>(nest.loops.size())) {
+            placeLevel(level + 1);
+        }
+        for (const auto& inst : nest.body) {
+            if (inst.depth == level && inst.afterInner) {
+                ordered.push_back(inst);
+            }
+        }
+    };
+    placeLevel(0);
+    
+    nest.body = ordered;
 }
 
-const std::vector<ThreeAddressInst>& Parser::getThreeAddressCode() const {
-    return threeAddressCode;
+const LoopNest& Parser::getLoopNest() const {
+    return nest;
 }
 
-void Parser::getMatrixDimensions(int& rows1, int& cols1, int& rows2, int& cols2) {
-    rows1 = matrixRows1;
-    cols1 = matrixCols1;
-    rows2 = matrixRows2;
-    cols2 = matrixCols2;
+const std::string& Parser::getKernelName() const {
+    return kernelName;
 }
\ No newline at end of file
@@ -4,32 +4,23 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <map>
+#include "loop_nest.h"
+#include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 
 // Forward declarations
 namespace llvm {
     class Function;
     class Loop;
+    class LoopInfo;
+    class ScalarEvolution;
+    class DominatorTree;
+    class Value;
+    class Type;
+    class PHINode;
 }
 
-// Represents a three-address instruction
-struct ThreeAddressInst {
-    enum class OpType {
-        LOAD,
-        STORE,
-        ADD,
-        MULTIPLY,
-        MOVE
-    };
-    
-    OpType op;
-    std::string dest;
-    std::string src1;
-    std::string src2;  // May be empty for LOAD/STORE
-    
-    std::string toString() const;
-};
-
 class Parser {
 public:
     Parser();
@@ -38,27 +29,66 @@ public:
     // Parse C++ file and generate LLVM IR
     bool parseFile(const std::string& filename);
     
-    // Get the generated three-address code
-    const std::vector<ThreeAddressInst>& getThreeAddressCode() const;
+    // Get the affine loop nest recovered from the kernel
+    const LoopNest& getLoopNest() const;
     
-    // Get matrix dimensions from the parsed code
-    void getMatrixDimensions(int& rows1, int& cols1, int& rows2, int& cols2);
+    // Get the name of the function the loop nest was taken from
+    const std::string& getKernelName() const;
     
 private:
-    // Convert LLVM IR to three-address code
-    void generateThreeAddressCode();
+    // Pick the function holding the deepest loop nest (preferring anything but main)
+    llvm::Function* findKernelFunction();
+    
+    // Recover loops, array accesses and the statement body from the kernel
+    bool analyzeKernel(llvm::Function& func);
+    
+    // Recover the bounds of one loop of the nest
+    bool processLoop(llvm::Loop* loop, int depth, llvm::ScalarEvolution& SE);
     
-    // Process a loop in the LLVM IR
-    void processLoop(llvm::Loop* loop);
+    // Give each scalar carried around a loop (a header phi other than the
+    // induction variable) an array slot per iteration of the enclosing loops
+    bool findReductions(llvm::ScalarEvolution& SE);
     
-    // LLVM module containing the parsed code
+    // Translate the instructions of the blocks that belong directly to a loop,
+    // failing on any instruction the body cannot express
+    bool processLoopBody(llvm::Loop* loop, int depth, llvm::LoopInfo& LI,
+                         llvm::DominatorTree& DT, llvm::ScalarEvolution& SE,
+                         std::map<llvm::Value*, Operand>& values);
+    
+    // Resolve a pointer to an array access with affine subscripts
+    bool resolveArrayAccess(llvm::Value* pointer, llvm::Type* elementType,
+                            llvm::ScalarEvolution& SE, ArrayAccess& access);
+    
+    // Put the body in program order: each level's leading instructions, the
+    // nested loop's body, then the level's trailing instructions
+    void orderBody();
+    
+    // LLVM context and module containing the parsed code
+    std::unique_ptr<llvm::LLVMContext> context;
     std::unique_ptr<llvm::Module> module;
     
-    // Three-address code representation
-    std::vector<ThreeAddressInst> threeAddressCode;
+    // Affine loop nest recovered from the kernel
+    std::string kernelName;
+    LoopNest nest;
+    
+    // LLVM loops and array base pointers matching nest.loops and nest.arrays
+    std::vector<llvm::Loop*> llvmLoops;
+    std::vector<llvm::Value*> arrayBases;
+    
+    // Induction variable of each loop of llvmLoops
+    std::vector<llvm::PHINode*> inductionPhis;
+    
+    // A scalar accumulated around a loop, kept in memory between iterations
+    struct Reduction {
+        llvm::PHINode* phi;        // Value at the start of an iteration
+        llvm::Value* latchValue;   // Value at the end of an iteration
+        int depth;                 // Index of the loop in llvmLoops
+        ArrayAccess access;        // Slot of the scalar for the current outer iterations
+    };
+    std::vector<Reduction> reductions;
     
-    // Matrix dimensions
-    int matrixRows1, matrixCols1, matrixRows2, matrixCols2;
+    // Header phis and latch values of the reductions, indexing reductions
+    std::map<llvm::Value*, size_t> reductionValues;
 };
 
 #endif // PARSER_H
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "peephole_optimizer.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Key of a row and column
+uint32_t locationKey(const PimInstruction& inst) {
+    return (static_cast<uint32_t>(inst.row_addr) << 16) | inst.col_addr;
+}
+
+// Drop the instructions marked as removed
+void compact(std::vector<PimInstruction>& instructions, const std::vector<bool>& removed) {
+    size_t kept = 0;
+    for (size_t i = 0; i < instructions.size(); i++) {
+        if (!removed[i]) {
+            instructions[kept++] = instructions[i];
+        }
+    }
+    instructions.resize(kept);
+}
+
+// Number of cores the instructions name
+int countCores(const std::vector<PimInstruction>& instructions) {
+    int cores = 1;
+    for (const auto& inst : instructions) {
+        cores = std::max(cores, inst.core_id + 1);
+    }
+    return cores;
+}
+
+} // namespace
+
+PeepholeOptimizer::PeepholeOptimizer(const MemoryMapper& memoryMapper)
+    : memoryMapper(memoryMapper) {
+}
+
+void PeepholeOptimizer::optimize(std::vector<PimInstruction>& instructions) {
+    bool changed = true;
+    while (changed) {
+        changed = propagateValues(instructions);
+        changed = removeDeadStores(instructions) || changed;
+    }
+}
+
+long PeepholeOptimizer::getCopiesPropagated() const {
+    return copiesPropagated;
+}
+
+long PeepholeOptimizer::getRedundantRemoved() const {
+    return redundantRemoved;
+}
+
+long PeepholeOptimizer::getDeadRemoved() const {
+    return deadRemoved;
+}
+
+bool PeepholeOptimizer::propagateValues(std::vector<PimInstruction>& instructions) {
+    size_t count = instructions.size();
+    int coreCount = countCores(instructions);
+    bool changed = false;
+    std::vector<bool> removed(count, false);
+    
+    // Next instruction of the same core
+    std::vector<long> nextOnCore(count, -1);
+    std::vector<long> lastOnCore(coreCount, -1);
+    for (long i = count - 1; i >= 0; i--) {
+        int core = instructions[i].core_id;
+        nextOnCore[i] = lastOnCore[core];
+        lastOnCore[core] = i;
+    }
+    
+    // Values are numbered; a location holds the number of the value last
+    // written to it, and a value's home is the location it was first stored
+    // in, for as long as that location still holds it. Value 0 is zero.
+    std::unordered_map<uint32_t, long> locationValue;
+    std::unordered_map<long, uint32_t> home;
+    
+    // Core that last wrote every location; a load taken from a location
+    // another core wrote would have to wait for that core
+    std::unordered_map<uint32_t, int> writer;
+    auto writerOf = [&](uint32_t key) {
+        auto it = writer.find(key);
+        return it != writer.end() ? it->second : -1;
+    };
+    long nextValue = 1;
+    std::vector<long> outValue(coreCount, -1);
+    std::vector<int> operandCount(coreCount, 0);
+    
+    auto valueAt = [&](uint32_t key) {
+        auto it = locationValue.find(key);
+        if (it != locationValue.end()) {
+            return it->second;
+        }
+        long value = nextValue++;
+        locationValue[key] = value;
+        home[value] = key;
+        return value;
+    };
+    auto write = [&](uint32_t key, long value, int core) {
+        locationValue[key] = value;
+        writer[key] = core;
+        auto it = home.find(value);
+        if (it == home.end() || valueAt(it->second) != value) {
+            home[value] = key;
+        }
+    };
+    auto redirect = [&](PimInstruction& inst, long value) {
+        auto it = home.find(value);
+        if (it != home.end() && it->second != locationKey(inst) && valueAt(it->second) == value) {
+            int homeWriter = writerOf(it->second);
+            if (homeWriter >= 0 && homeWriter != inst.core_id && homeWriter != writerOf(locationKey(inst))) {
+                return;
+            }
+            inst.row_addr = it->second >> 16;
+            inst.col_addr = it->second & 0xFFFF;
+            copiesPropagated++;
+            changed = true;
+        }
+    };
+    
+    for (size_t i = 0; i < count; i++) {
+        auto& inst = instructions[i];
+        int core = inst.core_id;
+        uint32_t key = locationKey(inst);
+        switch (inst.opcode) {
+            case Opcode::LOAD: {
+                // Loading the value the output register already holds, only
+                // for a STORE to write it, changes nothing
+                long value = valueAt(key);
+                if (value == outValue[core] && operandCount[core] == 0 && nextOnCore[i] >= 0 &&
+                    instructions[nextOnCore[i]].opcode == Opcode::STORE) {
+                    removed[i] = true;
+                    redundantRemoved++;
+                    changed = true;
+                    break;
+                }
+                redirect(inst, value);
+                outValue[core] = value;
+                operandCount[core]++;
+                break;
+            }
+            case Opcode::STORE: {
+                // Storing a value where it already is changes nothing
+                if (outValue[core] >= 0 && valueAt(key) == outValue[core] && operandCount[core] == 0) {
+                    removed[i] = true;
+                    redundantRemoved++;
+                    changed = true;
+                    break;
+                }
+                write(key, outValue[core], core);
+                operandCount[core] = 0;
+                break;
+            }
+            case Opcode::COMPUTE:
+                outValue[core] = nextValue++;
+                operandCount[core] = 0;
+                if (inst.flags & Flags::ACCUMULATE) {
+                    write(key, nextValue++, core);
+                }
+                break;
+            case Opcode::MOVE:
+                if (inst.flags & Flags::READ) {
+                    redirect(inst, valueAt(key));
+                    operandCount[core]++;
+                } else if (inst.flags & Flags::RESET) {
+                    write(key, 0, core);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    compact(instructions, removed);
+    return changed;
+}
+
+bool PeepholeOptimizer::removeDeadStores(std::vector<PimInstruction>& instructions) {
+    size_t count = instructions.size();
+    int coreCount = countCores(instructions);
+    bool changed = false;
+    std::vector<bool> removed(count, false);
+    
+    // Operands a STORE finds in its core's buffer, which it throws away
+    std::unordered_map<long, std::vector<long>> discardedOperands;
+    std::vector<std::vector<long>> pending(coreCount);
+    for (size_t i = 0; i < count; i++) {
+        const auto& inst = instructions[i];
+        int core = inst.core_id;
+        if (inst.opcode == Opcode::LOAD || (inst.opcode == Opcode::MOVE && (inst.flags & Flags::READ))) {
+            pending[core].push_back(i);
+        } else if (inst.opcode == Opcode::STORE || inst.opcode == Opcode::COMPUTE) {
+            if (inst.opcode == Opcode::STORE && !pending[core].empty()) {
+                discardedOperands[i] = pending[core];
+            }
+            pending[core].clear();
+        }
+    }
+    
+    // Walk backwards keeping the temporaries that are read before being
+    // written again, and for every core whether its output register is read
+    // before being set again; temporaries are dead at the end
+    std::unordered_set<uint32_t> live;
+    std::vector<bool> outputRead(coreCount, false);
+    for (long i = count - 1; i >= 0; i--) {
+        if (removed[i]) {
+            continue;
+        }
+        const auto& inst = instructions[i];
+        int core = inst.core_id;
+        uint32_t key = locationKey(inst);
+        bool dead = memoryMapper.isTemporaryRow(inst.row_addr) && live.count(key) == 0;
+        switch (inst.opcode) {
+            case Opcode::STORE: {
+                // A dead store goes; so do the loads it discards, unless the
+                // output register they set is read later
+                auto discarded = discardedOperands.find(i);
+                if (dead && discarded == discardedOperands.end()) {
+                    removed[i] = true;
+                    deadRemoved++;
+                    changed = true;
+                    break;
+                }
+                if (dead && !outputRead[core]) {
+                    removed[i] = true;
+                    for (long operand : discarded->second) {
+                        removed[operand] = true;
+                    }
+                    deadRemoved += 1 + discarded->second.size();
+                    changed = true;
+                    break;
+                }
+                live.erase(key);
+                outputRead[core] = true;
+                break;
+            }
+            case Opcode::LOAD:
+                live.insert(key);
+                outputRead[core] = false;
+                break;
+            case Opcode::COMPUTE:
+                if (inst.flags & Flags::ACCUMULATE) {
+                    live.insert(key);
+                }
+                outputRead[core] = false;
+                break;
+            case Opcode::MOVE:
+                if (inst.flags & Flags::READ) {
+                    live.insert(key);
+                } else if (inst.flags & Flags::WRITE) {
+                    if (dead) {
+                        removed[i] = true;
+                        deadRemoved++;
+                        changed = true;
+                        break;
+                    }
+                    live.erase(key);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    compact(instructions, removed);
+    return changed;
+}
\ No newline at end of file
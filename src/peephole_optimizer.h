@@ -0,0 +1,49 @@
+#ifndef PEEPHOLE_OPTIMIZER_H
+#define PEEPHOLE_OPTIMIZER_H
+
+#include "memory_mapper.h"
+#include "../include/pim_isa.h"
+#include <vector>
+
+// Removes wasteful patterns from the generated instruction stream: operands
+// copied into temporaries, values stored and loaded straight back, and
+// stores to temporaries nobody reads. The stream runs in order; each core
+// has an operand buffer (filled by LOAD and MOVE READ, emptied by STORE and
+// COMPUTE) and an output register (set by LOAD and COMPUTE, read by STORE).
+class PeepholeOptimizer {
+public:
+    PeepholeOptimizer(const MemoryMapper& memoryMapper);
+    
+    // Optimize the instructions in place, repeating until nothing changes
+    void optimize(std::vector<PimInstruction>& instructions);
+    
+    // Get the number of loads redirected to the original copy of a value
+    long getCopiesPropagated() const;
+    
+    // Get the number of loads and stores removed because the value was
+    // already in place
+    long getRedundantRemoved() const;
+    
+    // Get the number of instructions removed with dead stores
+    long getDeadRemoved() const;
+    
+private:
+    const MemoryMapper& memoryMapper;
+    
+    long copiesPropagated = 0;
+    long redundantRemoved = 0;
+    long deadRemoved = 0;
+    
+    // Track the value held by every location and register: redirect loads of
+    // a copy to the location the value was first stored in, unless another
+    // core wrote it there, and drop loads and stores that would leave
+    // everything as it is. Returns whether anything changed.
+    bool propagateValues(std::vector<PimInstruction>& instructions);
+    
+    // Remove stores to temporaries that are overwritten or never read
+    // before the end, together with the loads only feeding them. Returns
+    // whether anything changed.
+    bool removeDeadStores(std::vector<PimInstruction>& instructions);
+};
+
+#endif // PEEPHOLE_OPTIMIZER_H
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include "symbol_table.h"
+
+int SymbolTable::intern(const std::string& name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    
+    int id = names.size();
+    ids.emplace(name, id);
+    names.push_back(name);
+    return id;
+}
+
+int SymbolTable::lookup(const std::string& name) const {
+    auto it = ids.find(name);
+    return it != ids.end() ? it->second : -1;
+}
+
+const std::string& SymbolTable::name(int id) const {
+    return names[id];
+}
+
+int SymbolTable::size() const {
+    return names.size();
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Interns operand names into dense integer IDs so that later passes can use
+// flat arrays indexed by symbol instead of string-keyed maps
+class SymbolTable {
+public:
+    // Get the ID of a name, assigning the next free ID on first use
+    int intern(const std::string& name);
+    
+    // Get the ID of a name, or -1 if it was never interned
+    int lookup(const std::string& name) const;
+    
+    // Get the name behind an ID
+    const std::string& name(int id) const;
+    
+    // Get the number of interned symbols
+    int size() const;
+    
+private:
+    std::unordered_map<std::string, int> ids;
+    std::vector<std::string> names;
+};
+
+#endif // SYMBOL_TABLE_H
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "sync_placer.h"
+#include "target_config.h"
+#include <algorithm>
+
+namespace {
+
+// Key of a row and column
+uint32_t locationKey(const PimInstruction& inst) {
+    return (static_cast<uint32_t>(inst.row_addr) << 16) | inst.col_addr;
+}
+
+constexpr int cores = TargetConfig::maxCores;
+
+} // namespace
+
+SyncPlacer::SyncPlacer(InstructionSink* next)
+    : next(next), lastSignal(static_cast<size_t>(cores) * cores, -1), latest(cores, -1) {
+}
+
+void SyncPlacer::findWaits(const PimInstruction& inst, long index, long signalAfter) {
+    waits.clear();
+    bool reads = inst.opcode == Opcode::LOAD ||
+                 (inst.opcode == Opcode::MOVE && (inst.flags & Flags::READ)) ||
+                 (inst.opcode == Opcode::COMPUTE && (inst.flags & Flags::ACCUMULATE));
+    bool writes = inst.opcode == Opcode::STORE ||
+                  (inst.opcode == Opcode::MOVE && (inst.flags & (Flags::WRITE | Flags::RESET))) ||
+                  (inst.opcode == Opcode::COMPUTE && (inst.flags & Flags::ACCUMULATE));
+    if (!reads && !writes) {
+        return;
+    }
+    int core = inst.core_id % cores;
+    auto& location = locations[locationKey(inst)];
+    
+    auto conflict = [&](const Access& access) {
+        if (access.index >= 0 && access.core != core) {
+            if (latest[access.core] < 0) {
+                waitedCores.push_back(access.core);
+            }
+            latest[access.core] = std::max(latest[access.core], access.index);
+        }
+    };
+    conflict(location.lastWrite);
+    if (writes) {
+        for (const auto& reader : location.readers) {
+            conflict(reader);
+        }
+    }
+    
+    std::sort(waitedCores.begin(), waitedCores.end());
+    for (int other : waitedCores) {
+        long& signal = lastSignal[static_cast<size_t>(other) * cores + core];
+        if (signal < latest[other]) {
+            signal = signalAfter >= 0 ? signalAfter : latest[other];
+            waits.emplace_back(other, latest[other]);
+            syncPairs++;
+        }
+        latest[other] = -1;
+    }
+    waitedCores.clear();
+    
+    if (writes) {
+        location.lastWrite = {index, core};
+        location.readers.clear();
+    } else {
+        auto reader = std::find_if(location.readers.begin(), location.readers.end(),
+                                   [&](const Access& access) { return access.core == core; });
+        if (reader != location.readers.end()) {
+            reader->index = index;
+        } else {
+            location.readers.push_back({index, core});
+        }
+    }
+}
+
+void SyncPlacer::place(std::vector<PimInstruction>& instructions) {
+    long count = instructions.size();
+    
+    // SYNCs to insert, keyed by 2 * index for a wait before instruction index
+    // and 2 * index + 1 for a signal after it
+    std::vector<std::pair<long, PimInstruction>> inserts;
+    for (long i = 0; i < count; i++) {
+        findWaits(instructions[i], i, -1);
+        for (const auto& wait : waits) {
+            inserts.emplace_back(2 * wait.second + 1, signalInst(wait.first, instructions[i].core_id));
+            inserts.emplace_back(2 * i, waitInst(wait.first, instructions[i].core_id));
+        }
+    }
+    
+    if (inserts.empty()) {
+        return;
+    }
+    
+    // Merge the SYNCs into the stream; signals placed after the same
+    // instruction keep the order they were created in
+    std::stable_sort(inserts.begin(), inserts.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<PimInstruction> placed;
+    placed.reserve(count + inserts.size());
+    size_t next = 0;
+    for (long i = 0; i < count; i++) {
+        for (; next < inserts.size() && inserts[next].first == 2 * i; next++) {
+            placed.push_back(inserts[next].second);
+        }
+        placed.push_back(instructions[i]);
+        for (; next < inserts.size() && inserts[next].first == 2 * i + 1; next++) {
+            placed.push_back(inserts[next].second);
+        }
+    }
+    instructions = std::move(placed);
+}
+
+void SyncPlacer::emit(const PimInstruction& inst) {
+    findWaits(inst, streamed, streamed - 1);
+    streamed++;
+    for (const auto& wait : waits) {
+        next->emit(signalInst(wait.first, inst.core_id));
+        next->emit(waitInst(wait.first, inst.core_id));
+    }
+    next->emit(inst);
+}
+
+bool SyncPlacer::finish() {
+    return next == nullptr || next->finish();
+}
+
+long SyncPlacer::getSyncPairs() const {
+    return syncPairs;
+}
+
+PimInstruction SyncPlacer::signalInst(int from, int to) {
+    PimInstruction inst;
+    inst.opcode = Opcode::SYNC;
+    inst.core_id = from;
+    inst.row_addr = to;
+    inst.flags = Flags::WRITE;
+    return inst;
+}
+
+PimInstruction SyncPlacer::waitInst(int from, int to) {
+    PimInstruction inst;
+    inst.opcode = Opcode::SYNC;
+    inst.core_id = to;
+    inst.row_addr = from;
+    inst.flags = Flags::READ;
+    return inst;
+}
\ No newline at end of file
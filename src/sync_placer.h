@@ -0,0 +1,75 @@
+#ifndef SYNC_PLACER_H
+#define SYNC_PLACER_H
+
+#include "instruction_sink.h"
+#include "../include/pim_isa.h"
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Places SYNC instructions where a core touches a location another core
+// touched before: reading what it wrote, or overwriting what it read or
+// wrote. The two cores synchronize as a pair instead of with a barrier: the
+// first core's SYNC (flag WRITE, row = the other core) follows its last
+// access and signals the second, whose SYNC (flag READ, row = the first
+// core) waits for the signal before its access. Signals and waits between
+// two cores pair up in order. A pair already placed after the earlier access
+// is not repeated.
+class SyncPlacer : public InstructionSink {
+public:
+    // Place SYNCs into a whole program with place(), or into a stream of
+    // instructions emitted one by one and passed on to the next sink
+    SyncPlacer(InstructionSink* next = nullptr);
+    
+    // Insert the SYNC pairs into the instructions; each signal goes right
+    // after the access it follows
+    void place(std::vector<PimInstruction>& instructions);
+    
+    // Pass an instruction on to the next sink with the SYNC pairs it needs;
+    // the earlier access has already been passed on, so the signal goes right
+    // before the wait
+    void emit(const PimInstruction& inst) override;
+    bool finish() override;
+    
+    // Get the number of SYNC pairs inserted
+    long getSyncPairs() const;
+    
+private:
+    InstructionSink* next;
+    long syncPairs = 0;
+    long streamed = 0;
+    
+    // An instruction accessing a location, and its core
+    struct Access {
+        long index;
+        int core;
+    };
+    
+    // Last writer of every location, and the last reader on every core since
+    struct LocationState {
+        Access lastWrite = {-1, -1};
+        std::vector<Access> readers;
+    };
+    std::unordered_map<uint32_t, LocationState> locations;
+    
+    // Position of the last signal from core p to core c, as the index of the
+    // instruction it follows
+    std::vector<long> lastSignal;
+    
+    // Latest access by every other core the current instruction must wait for
+    std::vector<long> latest;
+    std::vector<int> waitedCores;
+    std::vector<std::pair<int, long>> waits;
+    
+    // Record the accesses of instruction index and find the cores it must
+    // wait for (into waits), with the index of their latest conflicting access; pairs
+    // covered by an earlier signal are left out. A new signal is taken to
+    // follow instruction signalAfter, or that latest access when it is -1.
+    void findWaits(const PimInstruction& inst, long index, long signalAfter);
+    
+    // SYNC signalling core "to" from core "from", and its wait
+    static PimInstruction signalInst(int from, int to);
+    static PimInstruction waitInst(int from, int to);
+};
+
+#endif // SYNC_PLACER_H
\ No newline at end of file
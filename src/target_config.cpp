@@ -0,0 +1,113 @@
+#include "target_config.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cctype>
+
+bool TargetConfig::loadFromFile(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Failed to open target description: " << filename << std::endl;
+        return false;
+    }
+    
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        
+        // Strip comments and skip blank lines
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line = line.substr(0, comment);
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                std::cerr << filename << ":" << lineNumber << ": expected key = value" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        
+        std::string key;
+        std::istringstream(line.substr(0, equals)) >> key;
+        
+        // Layouts take a name rather than a number
+        if (key.compare(0, 7, "layout_") == 0) {
+            std::string layout;
+            std::istringstream(line.substr(equals + 1)) >> layout;
+            if (!setLayout(key.substr(7), layout)) {
+                std::cerr << filename << ":" << lineNumber << ": invalid layout for " << key << std::endl;
+                return false;
+            }
+            continue;
+        }
+        
+        // So does the work distribution
+        if (key == "distribution") {
+            std::string distributionName;
+            std::istringstream(line.substr(equals + 1)) >> distributionName;
+            if (!distribution.parse(distributionName)) {
+                std::cerr << filename << ":" << lineNumber << ": invalid distribution " << distributionName << std::endl;
+                return false;
+            }
+            continue;
+        }
+        
+        std::istringstream valueStream(line.substr(equals + 1));
+        int value;
+        if (!(valueStream >> value) || value <= 0) {
+            std::cerr << filename << ":" << lineNumber << ": expected a positive integer for " << key << std::endl;
+            return false;
+        }
+        
+        if (key == "rows_per_subarray") {
+            rowsPerSubarray = value;
+        } else if (key == "row_buffer_bytes") {
+            rowBufferBytes = value;
+        } else if (key == "working_set_rows") {
+            workingSetRows = value;
+        } else if (key == "cores") {
+            if (value > maxCores) {
+                std::cerr << filename << ":" << lineNumber << ": at most " << maxCores << " cores are supported" << std::endl;
+                return false;
+            }
+            cores = value;
+        } else if (key == "load_latency") {
+            loadLatency = value;
+        } else if (key == "store_latency") {
+            storeLatency = value;
+        } else if (key == "lut_latency") {
+            lutLatency = value;
+        } else if (key == "compute_latency") {
+            computeLatency = value;
+        } else if (key == "move_latency") {
+            moveLatency = value;
+        } else if (key == "sync_latency") {
+            syncLatency = value;
+        } else if (key == "bus_width") {
+            busWidth = value;
+        } else {
+            std::cerr << filename << ":" << lineNumber << ": unknown key " << key << std::endl;
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool TargetConfig::setLayout(const std::string& matrix, const std::string& layout) {
+    if (matrix.size() != 1) {
+        return false;
+    }
+    int index = std::toupper(static_cast<unsigned char>(matrix[0])) - 'A';
+    if (index < 0 || index >= 3) {
+        return false;
+    }
+    return layouts[index].parse(layout);
+}
+
+int TargetConfig::elementsPerRow(int elementSize) const {
+    return elementSize > 0 && rowBufferBytes > elementSize ? rowBufferBytes / elementSize : 1;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef TARGET_CONFIG_H
+#define TARGET_CONFIG_H
+
+#include <string>
+#include "data_layout.h"
+#include "work_distribution.h"
+
+// Description of the PIM target the code is generated for
+struct TargetConfig {
+    int rowsPerSubarray = 512;   // DRAM rows in one subarray
+    int rowBufferBytes = 8192;   // Width of a subarray's row buffer
+    int workingSetRows = 256;    // Rows a core can keep in use across one tile
+    DataLayout layouts[3];       // Layouts of matrices A, B and C
+    int cores = 16;              // Cores the parallel iterations are spread over
+    WorkDistribution distribution;  // How they are spread
+    
+    // Cycles from issuing an instruction until its result can be used, and
+    // the number of LOAD, STORE and MOVE instructions the shared bus carries
+    // per cycle
+    int loadLatency = 4;
+    int storeLatency = 4;
+    int lutLatency = 32;
+    int computeLatency = 2;
+    int moveLatency = 8;
+    int syncLatency = 1;
+    int busWidth = 2;
+    
+    // Load settings from a file of "key = value" lines ('#' starts a comment);
+    // keys that are not present keep their current value
+    bool loadFromFile(const std::string& filename);
+    
+    // Set the layout of matrix A, B or C from its name ("row", "column",
+    // "blocked[:edge]" or "morton")
+    bool setLayout(const std::string& matrix, const std::string& layout);
+    
+    // Largest number of cores an instruction can name
+    static constexpr int maxCores = 64;
+    
+    // Number of elements of the given size that fit in one row
+    int elementsPerRow(int elementSize) const;
+};
+
+#endif // TARGET_CONFIG_H
\ No newline at end of file
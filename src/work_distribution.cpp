@@ -0,0 +1,130 @@
+#include "work_distribution.h"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+bool WorkDistribution::parse(const std::string& text) {
+    std::string name = text.substr(0, text.find(':'));
+    if (name == "block") {
+        kind = Kind::BLOCK;
+    } else if (name == "cyclic") {
+        kind = Kind::CYCLIC;
+    } else if (name == "block-cyclic") {
+        kind = Kind::BLOCK_CYCLIC;
+    } else if (name == "balanced") {
+        kind = Kind::BALANCED;
+    } else {
+        return false;
+    }
+    
+    // Only block-cyclic distributions take a block edge
+    blockSize = 0;
+    if (name.size() < text.size()) {
+        if (kind != Kind::BLOCK_CYCLIC) {
+            return false;
+        }
+        char* end;
+        long edge = std::strtol(text.c_str() + name.size() + 1, &end, 10);
+        if (*end != '\0' || edge <= 0) {
+            return false;
+        }
+        blockSize = static_cast<int>(edge);
+    }
+    return true;
+}
+
+std::string WorkDistribution::toString() const {
+    switch (kind) {
+        case Kind::BLOCK:
+            return "block";
+        case Kind::CYCLIC:
+            return "cyclic";
+        case Kind::BLOCK_CYCLIC:
+            return blockSize > 0 ? "block-cyclic:" + std::to_string(blockSize) : "block-cyclic";
+        case Kind::BALANCED:
+            return "balanced";
+        default:
+            return "unknown";
+    }
+}
+
+CoreAssignment::CoreAssignment(const WorkDistribution& distribution, int cores)
+    : distribution(distribution), cores(std::max(1, cores)) {
+}
+
+void CoreAssignment::chooseCoreGrid() {
+    long best = -1;
+    for (int r = 1; r <= cores; r++) {
+        if (cores % r != 0) {
+            continue;
+        }
+        int c = cores / r;
+        long busiest = static_cast<long>((rows + r - 1) / r) * ((cols + c - 1) / c);
+        if (best < 0 || busiest < best) {
+            best = busiest;
+            coreRows = r;
+            coreCols = c;
+        }
+    }
+}
+
+void CoreAssignment::assign(int rows, int cols, const std::vector<long>& costs) {
+    this->rows = rows;
+    this->cols = cols;
+    chooseCoreGrid();
+    unitCore.assign(static_cast<size_t>(rows) * cols, 0);
+    coreLoads.assign(cores, 0);
+    
+    if (distribution.kind == WorkDistribution::Kind::BALANCED) {
+        // Longest processing time first: take the units from the most to the
+        // least expensive and give each to the core with the fewest cycles
+        std::vector<int> order(unitCore.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return costs[a] > costs[b];
+        });
+        for (int unit : order) {
+            int core = std::min_element(coreLoads.begin(), coreLoads.end()) - coreLoads.begin();
+            unitCore[unit] = core;
+            coreLoads[core] += costs[unit];
+        }
+        return;
+    }
+    
+    int blockRows = (rows + coreRows - 1) / coreRows;
+    int blockCols = (cols + coreCols - 1) / coreCols;
+    int edge = distribution.blockSize > 0 ? distribution.blockSize : 2;
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            int coreRow, coreCol;
+            switch (distribution.kind) {
+                case WorkDistribution::Kind::BLOCK:
+                    coreRow = row / blockRows;
+                    coreCol = col / blockCols;
+                    break;
+                case WorkDistribution::Kind::CYCLIC:
+                    coreRow = row % coreRows;
+                    coreCol = col % coreCols;
+                    break;
+                default:
+                    coreRow = row / edge % coreRows;
+                    coreCol = col / edge % coreCols;
+                    break;
+            }
+            int unit = row * cols + col;
+            unitCore[unit] = coreRow * coreCols + coreCol;
+            coreLoads[unitCore[unit]] += costs[unit];
+        }
+    }
+}
+
+int CoreAssignment::coreOf(int row, int col) const {
+    if (row < 0 || row >= rows || col < 0 || col >= cols) {
+        return 0;
+    }
+    return unitCore[row * cols + col];
+}
+
+const std::vector<long>& CoreAssignment::getCoreLoads() const {
+    return coreLoads;
+}
\ No newline at end of file
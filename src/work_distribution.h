@@ -0,0 +1,63 @@
+#ifndef WORK_DISTRIBUTION_H
+#define WORK_DISTRIBUTION_H
+
+#include <string>
+#include <vector>
+
+// How the iterations of the parallel loops are spread over cores. The
+// iterations form a grid of units (tiles, or single iterations when a loop
+// is not tiled), and the cores form a grid of their own.
+struct WorkDistribution {
+    enum class Kind {
+        BLOCK,         // Each core takes one contiguous block of units
+        CYCLIC,        // Units are dealt out to the cores in turn
+        BLOCK_CYCLIC,  // Square blocks of units are dealt out in turn
+        BALANCED       // The most expensive units go to the least loaded core
+    };
+    
+    Kind kind = Kind::BALANCED;
+    int blockSize = 0;  // Edge of a BLOCK_CYCLIC block; 0 means 2
+    
+    // Parse "block", "cyclic", "block-cyclic", "block-cyclic:<edge>" or
+    // "balanced"
+    bool parse(const std::string& text);
+    
+    // Get the name of the distribution as accepted by parse
+    std::string toString() const;
+};
+
+// Assigns every unit of the grid of parallel iterations to a core
+class CoreAssignment {
+public:
+    CoreAssignment(const WorkDistribution& distribution, int cores);
+    
+    // Assign a grid of rows x cols units; costs holds the estimated cycles of
+    // every unit, row by row
+    void assign(int rows, int cols, const std::vector<long>& costs);
+    
+    // Get the core running a unit
+    int coreOf(int row, int col) const;
+    
+    // Get the estimated cycles of every core
+    const std::vector<long>& getCoreLoads() const;
+    
+private:
+    WorkDistribution distribution;
+    int cores;
+    
+    // Grid of units, and the grid of cores it is split over
+    int rows = 0;
+    int cols = 0;
+    int coreRows = 1;
+    int coreCols = 1;
+    
+    // Core of every unit, row by row
+    std::vector<int> unitCore;
+    std::vector<long> coreLoads;
+    
+    // Factor the cores into the grid that leaves the fewest units on the
+    // busiest core
+    void chooseCoreGrid();
+};
+
+#endif // WORK_DISTRIBUTION_H
\ No newline at end of file